@@ -0,0 +1,112 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Camera and light data every lighting shader reads, kept in one uniform buffer instead of being set on each program
+// with a glUniform call per value. The shaders include the block from resources/shaders/frame_uniforms.glsl:
+//
+//   struct PointLight {
+//       vec3 position;
+//       vec3 ambient;
+//       vec3 diffuse;
+//       vec3 specular;
+//       float constant;
+//       float linear;
+//       float quadratic;
+//   };
+//
+//   layout (std140) uniform FrameUniforms {
+//       mat4 projection;
+//       mat4 view;
+//       vec3 viewPos;
+//       PointLight pointLight;
+//       vec3 roomLightAmbient;
+//       vec3 roomLightDiffuse;
+//       vec3 roomLightSpecular;
+//   };
+//
+// and FrameUniformData below mirrors its std140 layout. GLSL 3.30 has no layout(binding = n), so every program gets the
+// block bound to FRAME_UNIFORMS_BINDING after linking (Shader does it, see BindFrameUniformBlock), the buffer is bound
+// there once and stays bound, so the data is written once a frame with one glBufferSubData whatever the number of
+// programs.
+
+enum { FRAME_UNIFORMS_BINDING = 0 };
+
+struct FrameUniformData {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    float padding0;
+    glm::vec3 lightPosition;
+    float padding1;
+    glm::vec3 lightAmbient;
+    float padding2;
+    glm::vec3 lightDiffuse;
+    float padding3;
+    glm::vec3 lightSpecular;
+    float lightConstant;   // packs into the last component of the vec3 before it, like std140 does
+    float lightLinear;
+    float lightQuadratic;
+    float padding4[2];     // structs are rounded up to 16 bytes
+    glm::vec3 roomLightAmbient;
+    float padding5;
+    glm::vec3 roomLightDiffuse;
+    float padding6;
+    glm::vec3 roomLightSpecular;
+    float padding7;
+};
+
+static_assert(offsetof(FrameUniformData, viewPos) == 128, "FrameUniformData doesn't match the std140 layout");
+static_assert(offsetof(FrameUniformData, lightPosition) == 144, "FrameUniformData doesn't match the std140 layout");
+static_assert(offsetof(FrameUniformData, lightConstant) == 204, "FrameUniformData doesn't match the std140 layout");
+static_assert(offsetof(FrameUniformData, roomLightAmbient) == 224, "FrameUniformData doesn't match the std140 layout");
+static_assert(sizeof(FrameUniformData) == 272, "FrameUniformData doesn't match the std140 layout");
+
+// binds the program's FrameUniforms block, if it has one, to FRAME_UNIFORMS_BINDING
+inline void BindFrameUniformBlock(GLuint program)
+{
+    GLuint index = glGetUniformBlockIndex(program, "FrameUniforms");
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, index, FRAME_UNIFORMS_BINDING);
+}
+
+// the buffer behind the FrameUniforms block, needs a current context
+class FrameUniforms
+{
+public:
+    FrameUniformData data;
+
+    FrameUniforms()
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniformData), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, buffer);
+    }
+
+    FrameUniforms(const FrameUniforms &) = delete;
+    FrameUniforms &operator=(const FrameUniforms &) = delete;
+
+    // writes data to the buffer, once a frame before the first draw
+    void Upload()
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniformData), &data);
+    }
+
+    // deletes the buffer, while the context is still current
+    void Release()
+    {
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+
+private:
+    GLuint buffer = 0;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <unordered_set>
+using namespace std;
+
+// enums of extensions the glad loader of this project wasn't generated with
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// the loader glad was initialized with, kept to look up entry points glad wasn't generated with
+inline GLADloadproc &glProcLoader()
+{
+    static GLADloadproc loader = nullptr;
+    return loader;
+}
+
+// to be called with the same loader as gladLoadGLLoader
+inline void SetGLProcLoader(GLADloadproc loader)
+{
+    glProcLoader() = loader;
+}
+
+// entry point of the current context by name, nullptr if it doesn't have it or no loader was set
+inline void *GetGLProc(const char *name)
+{
+    return glProcLoader() ? glProcLoader()(name) : nullptr;
+}
+
+// whether the context is at least the given GL version
+inline bool HasGLVersion(int major, int minor)
+{
+    return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+// whether the current context supports the named extension (e.g. "GL_EXT_texture_compression_s3tc"). The list is
+// read once, the first call needs a current context.
+inline bool HasGLExtension(const string &name)
+{
+    static unordered_set<string> extensions;
+    static bool loaded = false;
+    if (!loaded)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            extensions.insert((const char *)glGetStringi(GL_EXTENSIONS, i));
+        loaded = true;
+    }
+    return extensions.count(name) != 0;
+}
+
+// whether GL_COMPLETION_STATUS_KHR can be queried on shaders and programs, to poll a compile or link without waiting
+// for it (GL_KHR_parallel_shader_compile or its ARB twin)
+inline bool HasParallelShaderCompile()
+{
+    return HasGLExtension("GL_KHR_parallel_shader_compile") || HasGLExtension("GL_ARB_parallel_shader_compile");
+}
+
+// lets the driver compile and link on up to count threads of its own, 0xFFFFFFFF is as many as it likes. Returns false
+// without GL_KHR_parallel_shader_compile, the driver then decides on its own (many compile in the background anyway
+// as long as nobody asks for the status).
+inline bool SetMaxShaderCompilerThreads(GLuint count)
+{
+    typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+    MaxShaderCompilerThreadsProc maxThreads = nullptr;
+    if (HasGLExtension("GL_KHR_parallel_shader_compile"))
+        maxThreads = (MaxShaderCompilerThreadsProc)GetGLProc("glMaxShaderCompilerThreadsKHR");
+    else if (HasGLExtension("GL_ARB_parallel_shader_compile"))
+        maxThreads = (MaxShaderCompilerThreadsProc)GetGLProc("glMaxShaderCompilerThreadsARB");
+    if (!maxThreads)
+        return false;
+    maxThreads(count);
+    return true;
+}
+
+// whether textures with the given (compressed) internal format can be created. RGTC is core since GL 3.0, S3TC
+// needs GL_EXT_texture_compression_s3tc.
+inline bool IsTextureFormatSupported(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return HasGLExtension("GL_EXT_texture_compression_s3tc");
+    default:
+        return true;
+    }
+}
+
+#endif
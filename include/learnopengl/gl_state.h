@@ -0,0 +1,233 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+using namespace std;
+
+// Shadow copy of the GL bindings a frame changes most: the program, the vertex array, the textures and samplers of
+// every unit, the active unit and a few capabilities. Binding what is already bound is skipped, so callers can bind
+// what they need before every draw without knowing what the previous one left behind.
+//
+// Everything on the context thread that binds one of these has to go through here, or call Invalidate after (ImGui
+// does, its renderer saves and restores the state itself). Deleted objects have to be deleted through here too: GL
+// unbinds them, and a new object could get the same name.
+class GLState
+{
+public:
+    struct Stats {
+        size_t calls = 0;     // binds and enables asked for
+        size_t skipped = 0;   // of those, the ones that were redundant
+    };
+
+    static GLState &Instance()
+    {
+        static GLState instance;
+        return instance;
+    }
+
+    void UseProgram(GLuint program)
+    {
+        if (changed(this->program, program))
+            glUseProgram(program);
+    }
+
+    void BindVertexArray(GLuint vertexArray)
+    {
+        if (changed(this->vertexArray, vertexArray))
+            glBindVertexArray(vertexArray);
+    }
+
+    // makes GL_TEXTURE0 + unit the active unit
+    void ActiveTexture(GLuint unit)
+    {
+        if (changed(activeUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // binds the texture to the target of the given unit, switching the active unit only if it isn't bound there yet
+    void BindTexture(GLuint unit, GLenum target, GLuint texture)
+    {
+        int index = targetIndex(target);
+        if (unit >= MAX_UNITS || index < 0)
+        {
+            stats.calls++;
+            forceActiveTexture(unit);
+            glBindTexture(target, texture);
+            return;
+        }
+        if (!changed(textures[unit][index], texture))
+            return;
+        forceActiveTexture(unit);
+        glBindTexture(target, texture);
+    }
+
+    // binds the texture to the target of the active unit, for creating and uploading textures
+    void BindTexture(GLenum target, GLuint texture)
+    {
+        if (activeUnit == UNKNOWN)
+        {
+            // which unit's binding changes isn't known, so none of them are
+            stats.calls++;
+            glBindTexture(target, texture);
+            for (GLuint unit = 0; unit < MAX_UNITS; unit++)
+                forget(unit, target);
+            return;
+        }
+        BindTexture(activeUnit, target, texture);
+    }
+
+    void BindSampler(GLuint unit, GLuint sampler)
+    {
+        if (unit >= MAX_UNITS)
+        {
+            stats.calls++;
+            glBindSampler(unit, sampler);
+            return;
+        }
+        if (changed(samplers[unit], sampler))
+            glBindSampler(unit, sampler);
+    }
+
+    void SetCapability(GLenum capability, bool enabled)
+    {
+        int index = capabilityIndex(capability);
+        GLuint value = enabled ? 1 : 0;
+        if (index >= 0 && !changed(capabilities[index], value))
+            return;
+        if (index < 0)
+            stats.calls++;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    void Enable(GLenum capability)
+    {
+        SetCapability(capability, true);
+    }
+
+    void Disable(GLenum capability)
+    {
+        SetCapability(capability, false);
+    }
+
+    void CullFace(GLenum mode)
+    {
+        if (changed(cullFace, mode))
+            glCullFace(mode);
+    }
+
+    void DeleteTextures(GLsizei count, const GLuint *names)
+    {
+        for (GLsizei i = 0; i < count; i++)
+            for (GLuint unit = 0; unit < MAX_UNITS; unit++)
+                for (int index = 0; index < TARGET_COUNT; index++)
+                    if (textures[unit][index] == names[i])
+                        textures[unit][index] = 0;
+        glDeleteTextures(count, names);
+    }
+
+    void DeleteVertexArrays(GLsizei count, const GLuint *names)
+    {
+        for (GLsizei i = 0; i < count; i++)
+            if (vertexArray == names[i])
+                vertexArray = 0;
+        glDeleteVertexArrays(count, names);
+    }
+
+    // forgets everything, the next bind of each kind goes to GL. For after code that changes the state directly.
+    void Invalidate()
+    {
+        program = vertexArray = activeUnit = cullFace = UNKNOWN;
+        for (GLuint unit = 0; unit < MAX_UNITS; unit++)
+        {
+            for (int index = 0; index < TARGET_COUNT; index++)
+                textures[unit][index] = UNKNOWN;
+            samplers[unit] = UNKNOWN;
+        }
+        for (int index = 0; index < CAPABILITY_COUNT; index++)
+            capabilities[index] = UNKNOWN;
+    }
+
+    Stats GetStats() const
+    {
+        return stats;
+    }
+
+private:
+    enum { MAX_UNITS = 16, TARGET_COUNT = 4, CAPABILITY_COUNT = 5 };
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    GLuint program, vertexArray, activeUnit, cullFace;
+    GLuint textures[MAX_UNITS][TARGET_COUNT];   // by targetIndex
+    GLuint samplers[MAX_UNITS];
+    GLuint capabilities[CAPABILITY_COUNT];      // by capabilityIndex, 0 or 1
+    Stats stats;
+
+    GLState()
+    {
+        Invalidate();
+    }
+    GLState(const GLState &) = delete;
+    GLState &operator=(const GLState &) = delete;
+
+    // counts the call and records the value, returns whether it differs from the one recorded
+    bool changed(GLuint &current, GLuint value)
+    {
+        stats.calls++;
+        if (current == value)
+        {
+            stats.skipped++;
+            return false;
+        }
+        current = value;
+        return true;
+    }
+
+    // activates a unit for a bind that is already counted
+    void forceActiveTexture(GLuint unit)
+    {
+        if (activeUnit != unit)
+        {
+            activeUnit = unit;
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+    }
+
+    void forget(GLuint unit, GLenum target)
+    {
+        int index = targetIndex(target);
+        if (index >= 0)
+            textures[unit][index] = UNKNOWN;
+    }
+
+    static int targetIndex(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_CUBE_MAP: return 2;
+        case GL_TEXTURE_3D: return 3;
+        default: return -1;
+        }
+    }
+
+    static int capabilityIndex(GLenum capability)
+    {
+        switch (capability)
+        {
+        case GL_CULL_FACE: return 0;
+        case GL_DEPTH_TEST: return 1;
+        case GL_BLEND: return 2;
+        case GL_MULTISAMPLE: return 3;
+        case GL_SCISSOR_TEST: return 4;
+        default: return -1;
+        }
+    }
+};
+
+#endif
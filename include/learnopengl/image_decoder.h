@@ -0,0 +1,350 @@
+#ifndef IMAGE_DECODER_H
+#define IMAGE_DECODER_H
+
+#include <stb_image.h>
+
+#include <learnopengl/image_pool.h>
+
+#ifdef IMAGE_DECODER_JPEG
+#include <jpeglib.h>
+#endif
+#ifdef IMAGE_DECODER_PNG
+#include <png.h>
+#endif
+
+#include <atomic>
+#include <csetjmp>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Image files are decoded through a list of backends. Every file goes to the first backend that recognizes its
+// signature, stb_image is the last one and takes everything, it is also used when another backend fails on a file.
+// Optional backends are compiled in when CMake finds their library:
+//
+//   IMAGE_DECODER_JPEG  libjpeg, SIMD (SSE2/AVX2/NEON) IDCT and color conversion when it is libjpeg-turbo
+//   IMAGE_DECODER_PNG   libpng, SIMD row filters where it was built with them. Off unless USE_LIBPNG_DECODER is set:
+//                       it decodes the project's PNGs slower than stb_image (0.93x in decode_benchmark).
+//
+// All backends return 8 bit texels with the channels of the file (1 to 4), rows bottom up when the vertical flip is
+// on, the same as stbi_load with 0 requested channels. Decoding is thread safe, the flip is a process wide setting set
+// once on the main thread with SetImageFlipVertically, before any worker decodes.
+// Texels are allocated from the ImagePool, like stb_image's.
+
+inline atomic<bool> &imageFlipVertically()
+{
+    static atomic<bool> flip(false);
+    return flip;
+}
+
+// flips every decoded image vertically (so its first row is the bottom one, like OpenGL expects), for all backends.
+// Replaces stbi_set_flip_vertically_on_load.
+inline void SetImageFlipVertically(bool flip)
+{
+    imageFlipVertically() = flip;
+    stbi_set_flip_vertically_on_load(flip);
+}
+
+inline bool ImageFlipVertically()
+{
+    return imageFlipVertically();
+}
+
+class ImageDecoder
+{
+public:
+    virtual ~ImageDecoder() {}
+
+    virtual const char *Name() const = 0;
+
+    // whether the backend decodes files starting with these bytes (at least 8 of them, less if the file is shorter)
+    virtual bool Accepts(const uint8_t *signature, size_t size) const = 0;
+
+    // returns the texels of the file at path, to be given back with Free, or nullptr if it can't be decoded
+    virtual unsigned char *Decode(const string &path, bool flipVertically, int &width, int &height,
+                                  int &channels) const = 0;
+
+    virtual void Free(unsigned char *texels) const = 0;
+};
+
+class StbImageDecoder : public ImageDecoder
+{
+public:
+    const char *Name() const override
+    {
+        return "stb_image";
+    }
+
+    bool Accepts(const uint8_t *signature, size_t size) const override
+    {
+        return true;
+    }
+
+    unsigned char *Decode(const string &path, bool flipVertically, int &width, int &height, int &channels) const override
+    {
+        // stb_image 2.14 only has the process wide flag, which SetImageFlipVertically sets once on the main thread.
+        // Setting it here would race with the other workers, a caller (the benchmark) asking for the other
+        // orientation gets the rows swapped after decoding instead.
+        unsigned char *texels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+        if (texels && flipVertically != ImageFlipVertically())
+            flipRows(texels, (size_t)width * channels, height);
+        return texels;
+    }
+
+    void Free(unsigned char *texels) const override
+    {
+        stbi_image_free(texels);
+    }
+
+private:
+    static void flipRows(unsigned char *texels, size_t rowBytes, int height)
+    {
+        vector<unsigned char> row(rowBytes);
+        for (int top = 0, bottom = height - 1; top < bottom; top++, bottom--)
+        {
+            memcpy(row.data(), texels + top * rowBytes, rowBytes);
+            memcpy(texels + top * rowBytes, texels + bottom * rowBytes, rowBytes);
+            memcpy(texels + bottom * rowBytes, row.data(), rowBytes);
+        }
+    }
+};
+
+#ifdef IMAGE_DECODER_JPEG
+class JpegImageDecoder : public ImageDecoder
+{
+public:
+    const char *Name() const override
+    {
+#ifdef LIBJPEG_TURBO_VERSION
+        return "libjpeg-turbo";
+#else
+        return "libjpeg";
+#endif
+    }
+
+    bool Accepts(const uint8_t *signature, size_t size) const override
+    {
+        return size >= 3 && signature[0] == 0xFF && signature[1] == 0xD8 && signature[2] == 0xFF;
+    }
+
+    unsigned char *Decode(const string &path, bool flipVertically, int &width, int &height, int &channels) const override
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return nullptr;
+        jpeg_decompress_struct info;
+        ErrorManager error;
+        info.err = jpeg_std_error(&error.manager);
+        error.manager.error_exit = onError;
+        error.manager.output_message = onMessage;
+        // libjpeg reports errors by calling error_exit, which jumps back here. Nothing with a destructor may live
+        // between here and the calls into libjpeg.
+        unsigned char *volatile texels = nullptr;
+        if (setjmp(error.jump))
+        {
+            jpeg_destroy_decompress(&info);
+            fclose(file);
+            ImagePool::Instance().Free(texels);
+            return nullptr;
+        }
+        jpeg_create_decompress(&info);
+        jpeg_stdio_src(&info, file);
+        jpeg_read_header(&info, TRUE);
+        // CMYK and YCCK files are left to stb_image
+        if (info.jpeg_color_space == JCS_CMYK || info.jpeg_color_space == JCS_YCCK)
+            longjmp(error.jump, 1);
+        info.out_color_space = info.num_components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+        // the same upsampling stb_image does, so switching backends doesn't change the texels much
+        info.do_fancy_upsampling = TRUE;
+        info.dct_method = JDCT_ISLOW;
+        jpeg_start_decompress(&info);
+
+        size_t rowBytes = (size_t)info.output_width * info.output_components;
+        texels = (unsigned char *)ImagePool::Instance().Allocate(rowBytes * info.output_height);
+        if (!texels)
+            longjmp(error.jump, 1);
+        while (info.output_scanline < info.output_height)
+        {
+            JDIMENSION y = info.output_scanline;
+            JSAMPROW row = texels + (flipVertically ? info.output_height - 1 - y : y) * rowBytes;
+            jpeg_read_scanlines(&info, &row, 1);
+        }
+        width = (int)info.output_width;
+        height = (int)info.output_height;
+        channels = info.output_components;
+        jpeg_finish_decompress(&info);
+        jpeg_destroy_decompress(&info);
+        fclose(file);
+        return texels;
+    }
+
+    void Free(unsigned char *texels) const override
+    {
+        ImagePool::Instance().Free(texels);
+    }
+
+private:
+    struct ErrorManager {
+        jpeg_error_mgr manager;   // first, libjpeg only knows about this part
+        jmp_buf jump;
+    };
+
+    static void onError(j_common_ptr info)
+    {
+        longjmp(((ErrorManager *)info->err)->jump, 1);
+    }
+
+    // warnings about corrupt data are not worth printing, the fallback decoder gets to try the file anyway
+    static void onMessage(j_common_ptr info)
+    {
+    }
+};
+#endif
+
+#ifdef IMAGE_DECODER_PNG
+class PngImageDecoder : public ImageDecoder
+{
+public:
+    const char *Name() const override
+    {
+        return "libpng";
+    }
+
+    bool Accepts(const uint8_t *signature, size_t size) const override
+    {
+        return size >= 8 && png_sig_cmp((png_const_bytep)signature, 0, 8) == 0;
+    }
+
+    unsigned char *Decode(const string &path, bool flipVertically, int &width, int &height, int &channels) const override
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return nullptr;
+        png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, onError, onWarning);
+        png_infop info = png ? png_create_info_struct(png) : nullptr;
+        if (!info)
+        {
+            png_destroy_read_struct(png ? &png : nullptr, nullptr, nullptr);
+            fclose(file);
+            return nullptr;
+        }
+        // libpng reports errors by jumping back here, nothing with a destructor may live past this point
+        unsigned char *volatile texels = nullptr;
+        png_bytep *volatile rows = nullptr;
+        if (setjmp(png_jmpbuf(png)))
+        {
+            png_destroy_read_struct(&png, &info, nullptr);
+            fclose(file);
+            ImagePool::Instance().Free(texels);
+            free(rows);
+            return nullptr;
+        }
+        png_init_io(png, file);
+        png_read_info(png, info);
+        // 8 bits per channel, palettes expanded to RGB(A), transparency chunks to an alpha channel, like stb_image
+        png_set_expand(png);
+        png_set_strip_16(png);
+        png_set_interlace_handling(png);
+        png_read_update_info(png, info);
+
+        png_uint_32 w = png_get_image_width(png, info), h = png_get_image_height(png, info);
+        int c = png_get_channels(png, info);
+        size_t rowBytes = png_get_rowbytes(png, info);
+        texels = (unsigned char *)ImagePool::Instance().Allocate(rowBytes * h);
+        rows = (png_bytep *)malloc(sizeof(png_bytep) * h);
+        if (!texels || !rows || rowBytes != (size_t)w * c)
+            png_error(png, "out of memory");
+        for (png_uint_32 y = 0; y < h; y++)
+            rows[y] = texels + (flipVertically ? h - 1 - y : y) * rowBytes;
+        png_read_image(png, rows);
+        png_read_end(png, nullptr);
+        png_destroy_read_struct(&png, &info, nullptr);
+        fclose(file);
+        free(rows);
+        width = (int)w;
+        height = (int)h;
+        channels = c;
+        return texels;
+    }
+
+    void Free(unsigned char *texels) const override
+    {
+        ImagePool::Instance().Free(texels);
+    }
+
+private:
+    static void onError(png_structp png, png_const_charp message)
+    {
+        longjmp(png_jmpbuf(png), 1);
+    }
+
+    static void onWarning(png_structp png, png_const_charp message)
+    {
+    }
+};
+#endif
+
+// the backends in the order they are asked, stb_image last
+inline const vector<const ImageDecoder *> &ImageDecoders()
+{
+    static const vector<const ImageDecoder *> decoders = [] {
+        vector<const ImageDecoder *> list;
+#ifdef IMAGE_DECODER_JPEG
+        static const JpegImageDecoder jpeg;
+        list.push_back(&jpeg);
+#endif
+#ifdef IMAGE_DECODER_PNG
+        static const PngImageDecoder png;
+        list.push_back(&png);
+#endif
+        static const StbImageDecoder stb;
+        list.push_back(&stb);
+        return list;
+    }();
+    return decoders;
+}
+
+// the first backend in the list that accepts the file at path, stb_image if it can't be read
+inline const ImageDecoder *SelectImageDecoder(const string &path)
+{
+    const vector<const ImageDecoder *> &decoders = ImageDecoders();
+    uint8_t signature[8];
+    size_t size = 0;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file)
+    {
+        size = fread(signature, 1, sizeof(signature), file);
+        fclose(file);
+    }
+    for (const ImageDecoder *decoder : decoders)
+        if (size > 0 && decoder->Accepts(signature, size))
+            return decoder;
+    return decoders.back();
+}
+
+// decodes the image file at path with the backend that takes it, falling back to stb_image. The texels have to be
+// given back with FreeImage and the decoder returned in decoder. Returns nullptr if no backend could decode the file.
+inline unsigned char *DecodeImage(const string &path, int &width, int &height, int &channels, const ImageDecoder *&decoder)
+{
+    bool flip = ImageFlipVertically();
+    decoder = SelectImageDecoder(path);
+    unsigned char *texels = decoder->Decode(path, flip, width, height, channels);
+    if (!texels && decoder != ImageDecoders().back())
+    {
+        decoder = ImageDecoders().back();
+        texels = decoder->Decode(path, flip, width, height, channels);
+    }
+    return texels;
+}
+
+inline void FreeImage(unsigned char *texels, const ImageDecoder *decoder)
+{
+    if (texels)
+        decoder->Free(texels);
+}
+
+#endif
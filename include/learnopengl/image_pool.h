@@ -0,0 +1,192 @@
+#ifndef IMAGE_POOL_H
+#define IMAGE_POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+// Allocator for image decode buffers. Decoding a 4K texture allocates (and right after the upload frees) tens of
+// megabytes, and a model with many of them churns hundreds of megabytes through malloc, which maps and unmaps them
+// every time and fragments the heap. Blocks of 64 KB (2^POOL_MIN_SHIFT) and more are rounded up to a size class (four
+// per power of two, so at most 25% is wasted) and kept on a free list of their class when freed, for the next image of about the
+// same size. Smaller blocks (tables, scanlines) go straight to malloc.
+//
+// stb_image allocates through it (libs/stb_image.cpp defines STBI_MALLOC/STBI_REALLOC_SIZED/STBI_FREE), as do the
+// other image decoders. Thread safe, decoding runs on worker threads. Header only like the rest, the members are
+// implicitly inline so stb_image.cpp and the program share the one instance.
+class ImagePool
+{
+public:
+    struct Stats {
+        size_t allocations = 0;      // all Allocate calls
+        size_t reused = 0;           // pooled allocations served from a free list
+        size_t bytesInUse = 0;       // handed out and not freed yet, as requested
+        size_t peakBytesInUse = 0;
+        size_t bytesCached = 0;      // in free lists
+        size_t systemBytes = 0;      // allocated from the system in total, the churn the pool didn't absorb
+        size_t requestedBytes = 0;   // asked for in total, the churn without the pool
+    };
+
+    static ImagePool &Instance()
+    {
+        static ImagePool instance;
+        return instance;
+    }
+
+    void *Allocate(size_t size)
+    {
+        lock_guard<mutex> lock(guard);
+        stats.allocations++;
+        stats.requestedBytes += size;
+        int sizeClass = classOf(size);
+        BlockHeader *block = nullptr;
+        if (sizeClass >= 0 && !freeLists[sizeClass].empty())
+        {
+            block = freeLists[sizeClass].back();
+            freeLists[sizeClass].pop_back();
+            stats.bytesCached -= block->capacity;
+            stats.reused++;
+        }
+        else
+        {
+            size_t capacity = sizeClass >= 0 ? classBytes(sizeClass) : size;
+            block = (BlockHeader *)malloc(sizeof(BlockHeader) + capacity);
+            if (!block)
+                return nullptr;
+            block->capacity = capacity;
+            block->sizeClass = sizeClass;
+            stats.systemBytes += capacity;
+        }
+        block->size = size;
+        stats.bytesInUse += size;
+        stats.peakBytesInUse = max(stats.peakBytesInUse, stats.bytesInUse);
+        return block + 1;
+    }
+
+    // grows or shrinks in place when the block's size class has room, so stb_image's growing zlib output buffer
+    // doesn't copy on every doubling
+    void *Reallocate(void *pointer, size_t newSize)
+    {
+        if (!pointer)
+            return Allocate(newSize);
+        BlockHeader *block = (BlockHeader *)pointer - 1;
+        {
+            lock_guard<mutex> lock(guard);
+            if (newSize <= block->capacity && (block->sizeClass >= 0 || newSize == block->size))
+            {
+                stats.bytesInUse += newSize - block->size;
+                stats.peakBytesInUse = max(stats.peakBytesInUse, stats.bytesInUse);
+                block->size = newSize;
+                return pointer;
+            }
+        }
+        void *moved = Allocate(newSize);
+        if (moved)
+        {
+            memcpy(moved, pointer, min(block->size, newSize));
+            Free(pointer);
+        }
+        return moved;
+    }
+
+    void Free(void *pointer)
+    {
+        if (!pointer)
+            return;
+        BlockHeader *block = (BlockHeader *)pointer - 1;
+        lock_guard<mutex> lock(guard);
+        stats.bytesInUse -= block->size;
+        if (block->sizeClass >= 0 && stats.bytesCached + block->capacity <= cacheLimit)
+        {
+            freeLists[block->sizeClass].push_back(block);
+            stats.bytesCached += block->capacity;
+        }
+        else
+            free(block);
+    }
+
+    // bytes the free lists may keep, larger ones are dropped first when it is lowered
+    void SetCacheLimit(size_t bytes)
+    {
+        lock_guard<mutex> lock(guard);
+        cacheLimit = bytes;
+        trim(bytes);
+    }
+
+    // gives every cached block back to the system, e.g. once all textures are loaded
+    void Trim()
+    {
+        lock_guard<mutex> lock(guard);
+        trim(0);
+    }
+
+    Stats GetStats()
+    {
+        lock_guard<mutex> lock(guard);
+        return stats;
+    }
+
+private:
+    // in front of every block, a multiple of 16 bytes so the data stays aligned like malloc's
+    struct alignas(16) BlockHeader {
+        size_t capacity;
+        size_t size;
+        int sizeClass;   // -1 for blocks that go straight to malloc
+    };
+    enum { POOL_MIN_SHIFT = 16, POOL_MAX_SHIFT = 31, CLASSES_PER_POWER = 4 };
+    enum { CLASS_COUNT = (POOL_MAX_SHIFT - POOL_MIN_SHIFT) * CLASSES_PER_POWER };
+
+    mutex guard;
+    vector<BlockHeader *> freeLists[CLASS_COUNT];
+    size_t cacheLimit = (size_t)256 << 20;
+    Stats stats;
+
+    ImagePool() {}
+    ~ImagePool()
+    {
+        trim(0);
+    }
+    ImagePool(const ImagePool &) = delete;
+    ImagePool &operator=(const ImagePool &) = delete;
+
+    // size class of a request, -1 if it isn't pooled. Class i of power p holds blocks of (4 + i) / 4 * 2^p bytes.
+    static int classOf(size_t size)
+    {
+        if (size < ((size_t)1 << POOL_MIN_SHIFT) || size > ((size_t)1 << POOL_MAX_SHIFT))
+            return -1;
+        int power = POOL_MIN_SHIFT;
+        while (((size_t)2 << power) <= size)
+            power++;
+        size_t step = (size_t)1 << (power - 2);
+        size_t steps = (size + step - 1) / step;   // 4 to 8
+        int sizeClass = (power - POOL_MIN_SHIFT) * CLASSES_PER_POWER + (int)steps - 4;
+        return sizeClass < CLASS_COUNT ? sizeClass : -1;
+    }
+
+    static size_t classBytes(int sizeClass)
+    {
+        int power = POOL_MIN_SHIFT + sizeClass / CLASSES_PER_POWER;
+        return ((size_t)(4 + sizeClass % CLASSES_PER_POWER) << power) / 4;
+    }
+
+    void trim(size_t limit)
+    {
+        for (int sizeClass = CLASS_COUNT - 1; sizeClass >= 0 && stats.bytesCached > limit; sizeClass--)
+        {
+            vector<BlockHeader *> &blocks = freeLists[sizeClass];
+            while (!blocks.empty() && stats.bytesCached > limit)
+            {
+                stats.bytesCached -= blocks.back()->capacity;
+                free(blocks.back());
+                blocks.pop_back();
+            }
+        }
+    }
+};
+
+#endif
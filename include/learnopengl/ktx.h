@@ -0,0 +1,217 @@
+#ifndef KTX_H
+#define KTX_H
+
+#include <learnopengl/mapped_file.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Reader and writer for 2D textures in the KTX 1.1 container (https://registry.khronos.org/KTX/specs/1.0/ktxspec.v1.html),
+// which stores the GL format enums and a complete mip chain, so a texture goes from file to GL without any conversion.
+// Only what the textures of this project use is supported: little endian files, one face, no array layers and no
+// depth. Key/value data is limited to string values.
+const unsigned char KTX_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct KtxHeader {
+    unsigned char identifier[12];
+    uint32_t endianness;
+    uint32_t glType;                // 0 for compressed formats
+    uint32_t glTypeSize;
+    uint32_t glFormat;              // 0 for compressed formats
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+// one mip level of a texture, for writing
+struct KtxLevel {
+    vector<uint8_t> data;
+};
+
+// a level of an uncompressed format from tightly packed texels. KTX stores every row padded to 4 bytes, the layout
+// glTexImage2D reads with the default GL_UNPACK_ALIGNMENT.
+inline KtxLevel KtxUncompressedLevel(const uint8_t *texels, int width, int height, int texelBytes)
+{
+    size_t rowBytes = (size_t)width * texelBytes;
+    size_t paddedRowBytes = (rowBytes + 3) & ~(size_t)3;
+    KtxLevel level;
+    level.data.assign(paddedRowBytes * height, 0);
+    for (int y = 0; y < height; y++)
+        memcpy(level.data.data() + y * paddedRowBytes, texels + y * rowBytes, rowBytes);
+    return level;
+}
+
+// a KTX file mapped into memory, the level data points into the mapping
+class KtxFile
+{
+public:
+    bool Open(const string &path)
+    {
+        levels.clear();
+        if (!file.open(path))
+            return false;
+        if (!parse())
+        {
+            levels.clear();
+            file.close();
+            return false;
+        }
+        return true;
+    }
+
+    const KtxHeader &Header() const
+    {
+        return header;
+    }
+
+    size_t Levels() const
+    {
+        return levels.size();
+    }
+
+    const uint8_t *LevelData(size_t level) const
+    {
+        return levels[level].data;
+    }
+
+    size_t LevelSize(size_t level) const
+    {
+        return levels[level].size;
+    }
+
+    // the string value stored under key in the key/value data, empty if there is none
+    string Value(const string &key) const
+    {
+        const unsigned char *data = file.data() + sizeof(KtxHeader);
+        size_t size = header.bytesOfKeyValueData;
+        size_t offset = 0;
+        while (offset + sizeof(uint32_t) <= size)
+        {
+            uint32_t pairSize;
+            memcpy(&pairSize, data + offset, sizeof(pairSize));
+            offset += sizeof(pairSize);
+            if (size - offset < pairSize)
+                break;
+            // key and value are both NUL terminated
+            const char *entry = (const char *)data + offset;
+            size_t keyLength = strnlen(entry, pairSize);
+            if (keyLength < pairSize && key.compare(0, string::npos, entry, keyLength) == 0)
+                return string(entry + keyLength + 1, strnlen(entry + keyLength + 1, pairSize - keyLength - 1));
+            offset += pairSize + (4 - pairSize % 4) % 4;
+        }
+        return string();
+    }
+
+    // writes a 2D texture with its mip chain, level 0 first. glType and glFormat are 0 for compressed formats. Written
+    // under a temporary name and renamed, like the mesh cache.
+    static bool Write(const string &path, uint32_t glType, uint32_t glTypeSize, uint32_t glFormat, uint32_t glInternalFormat,
+                      uint32_t glBaseInternalFormat, uint32_t width, uint32_t height, const vector<KtxLevel> &levels,
+                      const vector<pair<string, string>> &keyValues = {})
+    {
+        static const char padding[4] = {0, 0, 0, 0};
+        string keyValueData;
+        for (const pair<string, string> &keyValue : keyValues)
+        {
+            uint32_t pairSize = (uint32_t)(keyValue.first.size() + keyValue.second.size() + 2);
+            keyValueData.append((const char *)&pairSize, sizeof(pairSize));
+            keyValueData.append(keyValue.first.c_str(), keyValue.first.size() + 1);
+            keyValueData.append(keyValue.second.c_str(), keyValue.second.size() + 1);
+            keyValueData.append(padding, (4 - pairSize % 4) % 4);
+        }
+
+        string tmpPath = path + ".tmp";
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if (!out)
+            return false;
+
+        KtxHeader header;
+        memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+        header.endianness = 0x04030201;
+        header.glType = glType;
+        header.glTypeSize = glTypeSize;
+        header.glFormat = glFormat;
+        header.glInternalFormat = glInternalFormat;
+        header.glBaseInternalFormat = glBaseInternalFormat;
+        header.pixelWidth = width;
+        header.pixelHeight = height;
+        header.pixelDepth = 0;
+        header.numberOfArrayElements = 0;
+        header.numberOfFaces = 1;
+        header.numberOfMipmapLevels = (uint32_t)levels.size();
+        header.bytesOfKeyValueData = (uint32_t)keyValueData.size();
+        out.write((const char *)&header, sizeof(header));
+        out.write(keyValueData.data(), keyValueData.size());
+
+        for (const KtxLevel &level : levels)
+        {
+            uint32_t imageSize = (uint32_t)level.data.size();
+            out.write((const char *)&imageSize, sizeof(imageSize));
+            out.write((const char *)level.data.data(), imageSize);
+            out.write(padding, (4 - imageSize % 4) % 4);
+        }
+        out.close();
+        if (!out)
+        {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    struct Level {
+        const uint8_t *data;
+        size_t size;
+    };
+    MappedFile file;
+    KtxHeader header;
+    vector<Level> levels;
+
+    bool parse()
+    {
+        const unsigned char *data = file.data();
+        size_t size = file.size();
+        if (size < sizeof(KtxHeader))
+            return false;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 || header.endianness != 0x04030201 ||
+            header.pixelDepth > 1 || header.numberOfArrayElements > 0 || header.numberOfFaces != 1 ||
+            header.pixelWidth == 0 || header.pixelHeight == 0)
+            return false;
+
+        size_t offset = sizeof(header);
+        if (size - offset < header.bytesOfKeyValueData)
+            return false;
+        offset += header.bytesOfKeyValueData;
+        uint32_t levelCount = header.numberOfMipmapLevels ? header.numberOfMipmapLevels : 1;
+        for (uint32_t level = 0; level < levelCount; level++)
+        {
+            uint32_t imageSize;
+            if (size - offset < sizeof(imageSize))
+                return false;
+            memcpy(&imageSize, data + offset, sizeof(imageSize));
+            offset += sizeof(imageSize);
+            if (size - offset < imageSize)
+                return false;
+            levels.push_back(Level{data + offset, imageSize});
+            offset += imageSize + (4 - imageSize % 4) % 4;
+            if (offset > size)
+                offset = size;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef MATERIAL_LIBRARY_H
+#define MATERIAL_LIBRARY_H
+
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/text_scan.h>
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// The texture maps of the materials in an OBJ material library (.mtl). The native OBJ loader and the texture baker
+// both read libraries through here, so they resolve map statements to the same file names. No GL dependency, tools use
+// it too.
+//
+// Maps the MTL format has no statement for (ambient occlusion, map_ao) can be given in a sidecar file next to the
+// library instead of editing it: backpack.mtl -> backpack.mtl.maps, in MTL syntax (newmtl and map statements). Its
+// maps are added to the materials of the same name.
+
+enum MaterialMapKind {
+    MATERIAL_MAP_DIFFUSE,     // map_Kd
+    MATERIAL_MAP_SPECULAR,    // map_Ks
+    MATERIAL_MAP_NORMAL,      // map_Bump, map_bump, bump
+    MATERIAL_MAP_HEIGHT,      // map_Ka
+    MATERIAL_MAP_OCCLUSION,   // map_ao
+    MATERIAL_MAP_KINDS
+};
+
+// the maps of one material by kind, in the order the library lists them, relative to the library's directory
+struct MaterialMaps {
+    vector<string> maps[MATERIAL_MAP_KINDS];
+};
+
+class MaterialLibrary
+{
+public:
+    // path of the sidecar file of the library at path
+    static string SidecarPath(const string &path)
+    {
+        return path + ".maps";
+    }
+
+    // reads the maps of every material of the library at path and of its sidecar, if it has one, into materials, by
+    // material name. Returns false if the library can't be read.
+    static bool Read(const string &path, map<string, MaterialMaps> &materials)
+    {
+        if (!readFile(path, materials))
+            return false;
+        readFile(SidecarPath(path), materials);
+        return true;
+    }
+
+    // the file name of a map statement, given the line after its keyword. Map statements may carry options
+    // ("map_Bump -bm 1.0 normal.png"), the file name is the rest of the line after them and may contain blanks.
+    static string MapFileName(const char *begin, const char *end)
+    {
+        auto tokenEnd = [end](const char *p) {
+            while (p < end && !IsBlank(*p) && *p != '\r')
+                p++;
+            return p;
+        };
+        auto isNumber = [end](const char *p) {
+            if (p < end && (*p == '-' || *p == '+'))
+                p++;
+            if (p < end && *p == '.')
+                p++;
+            return p < end && *p >= '0' && *p <= '9';
+        };
+        const char *p = SkipBlanks(begin, end);
+        while (p < end && *p == '-' && !isNumber(p))
+        {
+            const char *optionEnd = tokenEnd(p);
+            string option(p, optionEnd);
+            p = SkipBlanks(optionEnd, end);
+            // -o, -s and -t take one to three numbers, the switches (on/off, a channel, a projection) one word
+            int numbers = 0, words = 0;
+            if (option == "-o" || option == "-s" || option == "-t")
+                numbers = 3;
+            else if (option == "-mm")
+                numbers = 2;
+            else if (option == "-bm" || option == "-boost" || option == "-texres")
+                numbers = 1;
+            else if (option == "-blendu" || option == "-blendv" || option == "-clamp" || option == "-cc" ||
+                     option == "-imfchan" || option == "-type")
+                words = 1;
+            for (int i = 0; i < words && p < end; i++)
+                p = SkipBlanks(tokenEnd(p), end);
+            for (int i = 0; i < numbers && isNumber(p); i++)
+                p = SkipBlanks(tokenEnd(p), end);
+        }
+        return TrimBlanks(p, end);
+    }
+
+private:
+    static bool readFile(const string &path, map<string, MaterialMaps> &materials)
+    {
+        MappedFile file;
+        if (!file.open(path))
+            return false;
+        MaterialMaps *current = nullptr;
+        const char *data = (const char *)file.data();
+        const char *dataEnd = data + file.size();
+        for (const char *p = data; p < dataEnd;)
+        {
+            const char *end = (const char *)memchr(p, '\n', dataEnd - p);
+            if (!end)
+                end = dataEnd;
+            const char *lineStart = SkipBlanks(p, end);
+            p = end + 1;
+
+            if (IsKeyword(lineStart, end, "newmtl", 6))
+            {
+                current = &materials[TrimBlanks(lineStart + 6, end)];
+                continue;
+            }
+            if (!current)
+                continue;
+            if (IsKeyword(lineStart, end, "map_Kd", 6))
+                current->maps[MATERIAL_MAP_DIFFUSE].push_back(MapFileName(lineStart + 6, end));
+            else if (IsKeyword(lineStart, end, "map_Ks", 6))
+                current->maps[MATERIAL_MAP_SPECULAR].push_back(MapFileName(lineStart + 6, end));
+            else if (IsKeyword(lineStart, end, "map_Bump", 8) || IsKeyword(lineStart, end, "map_bump", 8))
+                current->maps[MATERIAL_MAP_NORMAL].push_back(MapFileName(lineStart + 8, end));
+            else if (IsKeyword(lineStart, end, "bump", 4))
+                current->maps[MATERIAL_MAP_NORMAL].push_back(MapFileName(lineStart + 4, end));
+            else if (IsKeyword(lineStart, end, "map_Ka", 6))
+                current->maps[MATERIAL_MAP_HEIGHT].push_back(MapFileName(lineStart + 6, end));
+            else if (IsKeyword(lineStart, end, "map_ao", 6))
+                current->maps[MATERIAL_MAP_OCCLUSION].push_back(MapFileName(lineStart + 6, end));
+        }
+        return true;
+    }
+};
+
+#endif
@@ -2,13 +2,21 @@
 #define MESH_H
 
 #include <glad/glad.h> // holds all OpenGL type declarations
+#include <sys/stat.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/gl_state.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/texture_packing.h>
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -25,6 +33,55 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// opt-in 20 byte GPU vertex layout (vs 56 bytes for Vertex). The bitangent is not stored, a normal mapping shader would
+// rebuild it as cross(normal, tangent) * handedness. Positions are quantized within the bounds of their mesh, the
+// shader gets them back with the mesh's positionScale and positionOffset uniforms (set by Mesh::Draw). Decoding lives
+// in 2.model_lighting_compact.vs.
+struct CompactVertex {
+    uint16_t Position[4];  // unorm16 xyz within the mesh bounds, w holds the tangent handedness (0: -1, 65535: +1)
+    int16_t  Normal[2];    // octahedral encoded unit normal, snorm16
+    int16_t  Tangent[2];   // octahedral encoded unit tangent, snorm16
+    uint16_t TexCoords[2]; // half float uv
+};
+
+enum class VertexFormat {
+    Full,
+    Compact
+};
+
+// maps a unit vector onto the [-1, 1]^2 square of an octahedron unfolded around +z
+inline glm::vec2 OctahedralEncode(glm::vec3 n)
+{
+    float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (l1 == 0.0f)
+        return glm::vec2(0.0f, 0.0f);
+    n /= l1;
+    if (n.z >= 0.0f)
+        return glm::vec2(n.x, n.y);
+    return glm::vec2((1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                     (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+// boundsMin and boundsSize are those of the mesh the vertex belongs to, a flat axis (size 0) quantizes to 0
+inline CompactVertex CompressVertex(const Vertex &vertex, glm::vec3 boundsMin, glm::vec3 boundsSize)
+{
+    CompactVertex compact;
+    float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? 0.0f : 1.0f;
+    glm::vec3 scale = glm::max(boundsSize, glm::vec3(1e-30f));
+    glm::vec3 position = glm::clamp((vertex.Position - boundsMin) / scale, 0.0f, 1.0f);
+    uint32_t packed[5] = {
+        glm::packUnorm2x16(glm::vec2(position.x, position.y)),
+        glm::packUnorm2x16(glm::vec2(position.z, handedness)),
+        glm::packSnorm2x16(OctahedralEncode(vertex.Normal)),
+        glm::packSnorm2x16(OctahedralEncode(vertex.Tangent)),
+        glm::packHalf2x16(vertex.TexCoords)
+    };
+    // glm packs the first component into the low bits, which matches the in memory order of the arrays on little endian
+    static_assert(sizeof(CompactVertex) == sizeof(packed), "CompactVertex must be tightly packed");
+    memcpy(&compact, packed, sizeof(packed));
+    return compact;
+}
+
 
 
 struct Texture {
@@ -33,37 +90,191 @@ struct Texture {
     string path;
 };
 
+// a texture as referenced by a material, before it is resolved to a GL texture
+struct TextureRef {
+    string type;
+    string path;
+};
+
+// whether textures of the type hold sRGB colors, as opposed to data like normals or specular intensity
+inline bool IsColorTexture(const string &type)
+{
+    return type == "texture_diffuse";
+}
+
+// the textures of a material with its scalar maps replaced by their packed texture (see texture_packing.h) if that is
+// baked and at least as new as all the maps packed into it. Occlusion maps are only used packed, they are left out
+// otherwise. Paths are relative to directory.
+inline vector<TextureRef> PackedTextureRefs(const string &directory, const vector<TextureRef> &textures)
+{
+    string maps[PACKED_CHANNELS];
+    for (const TextureRef &texture : textures)
+    {
+        int channel = PackedChannelForType(texture.type);
+        if (channel >= 0 && maps[channel].empty())
+            maps[channel] = texture.path;
+    }
+    auto unpacked = [&textures]() {
+        vector<TextureRef> result;
+        for (const TextureRef &texture : textures)
+            if (PackedChannelForType(texture.type) != PACKED_OCCLUSION)
+                result.push_back(texture);
+        return result;
+    };
+    string packed = PackedTexturePath(maps);
+    struct stat baked, map;
+    if (packed.empty() || stat((directory + '/' + packed + ".ktx").c_str(), &baked) != 0)
+        return unpacked();
+    for (const string &path : maps)
+        if (!path.empty() && stat((directory + '/' + path).c_str(), &map) == 0 && map.st_mtime > baked.st_mtime)
+            return unpacked();
+
+    vector<TextureRef> result;
+    for (const TextureRef &texture : textures)
+    {
+        int channel = PackedChannelForType(texture.type);
+        if (channel < 0 || maps[channel] != texture.path)
+            result.push_back(texture);
+    }
+    result.push_back(TextureRef{"texture_packed", packed});
+    return result;
+}
+
+// one level of detail of a mesh: a range of its index buffer, drawn with the vertices all levels share
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;   // how far the simplified surface may be off the full one, in model space units
+};
+
+// CPU side mesh as produced by the importers, before it is turned into a Mesh
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;   // all LODs back to back, LOD 0 first
+    vector<TextureRef>   textures;
+    vector<MeshLod>      lods;      // empty if the mesh has no LODs, i.e. all indices are LOD 0
+};
+
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data. vertices and indices are only kept on the CPU until ReleaseGeometry is called (or not at all for
+    // meshes created from borrowed data), the counts and bounds below stay valid for the lifetime of the mesh.
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    vector<MeshLod>      lods;   // at least one, lods[0] is the full resolution mesh
 
     unsigned int VAO;
-    std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    unsigned int vertexCount;
+    unsigned int indexCount;   // of all LODs
+    GLenum indexType;   // GL_UNSIGNED_SHORT for meshes with up to 65536 vertices, GL_UNSIGNED_INT otherwise
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    float uvDensity;   // UV units per model space unit, averaged over the surface of LOD 0
+    VertexFormat vertexFormat;
+    // constructor, takes over the given buffers without copying them
+    Mesh(vector<Vertex> &&vertices, vector<unsigned int> &&indices, vector<Texture> &&textures,
+         VertexFormat format = VertexFormat::Full, vector<MeshLod> &&lods = vector<MeshLod>())
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), lods(std::move(lods)),
+          vertexFormat(format)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+        resolveSamplerNames();
+    }
+
+    // constructor for geometry that lives in memory the mesh doesn't own (e.g. a mapped mesh cache file).
+    // The data is uploaded straight from the given pointers and no CPU side copy is kept.
+    Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<Texture> &&textures,
+         VertexFormat format = VertexFormat::Full, vector<MeshLod> &&lods = vector<MeshLod>())
+        : textures(std::move(textures)), lods(std::move(lods)), vertexFormat(format)
+    {
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
+        resolveSamplerNames();
+    }
+
+    // prefix of the sampler uniforms the textures are bound to, e.g. "material." for material.texture_diffuse1
+    void SetGlslIdentifierPrefix(const string &prefix)
+    {
+        glslIdentifierPrefix = prefix;
+        resolveSamplerNames();
+    }
+
+    // frees the CPU copy of the geometry once it lives in the GPU buffers, only counts and bounds are kept
+    void ReleaseGeometry()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // coarsest LOD whose error stays within maxPixelError pixels when one model space unit covers pixelsPerUnit pixels
+    unsigned int SelectLod(float pixelsPerUnit, float maxPixelError) const
+    {
+        unsigned int lod = (unsigned int)lods.size() - 1;
+        while (lod > 0 && lods[lod].error * pixelsPerUnit > maxPixelError)
+            lod--;
+        return lod;
+    }
+
+    // render the mesh, at full resolution unless a coarser LOD is asked for. pixelsPerUnit is how many screen pixels
+    // one model space unit covers at most, it tells the texture cache which mip levels the draw needs (0: all of them).
+    void Draw(Shader &shader, unsigned int lod = 0, float pixelsPerUnit = 0.0f)
+    {
+        float uvPerPixel = pixelsPerUnit > 0.0f ? uvDensity / pixelsPerUnit : 0.0f;
+        // textures changed since the names were resolved
+        if (samplerNames.size() != textures.size())
+            resolveSamplerNames();
+        GLState &state = GLState::Instance();
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            // set the sampler to the correct texture unit
+            shader.setInt(samplerNames[i], i);
+            // and bind the texture, activating its unit only if it isn't bound there already
+            state.BindTexture(i, GL_TEXTURE_2D, textures[i].id);
+            TextureCache::Instance().Touch(textures[i].id, uvPerPixel);
+        }
+        // tells the shader whether the scalar maps come packed in texture_packed1 or as separate textures
+        shader.setBool(packedName, packed);
+        // maps the quantized positions of a compact mesh back onto its bounds
+        if (vertexFormat == VertexFormat::Compact)
+        {
+            shader.setVec3("positionScale", boundsMax - boundsMin);
+            shader.setVec3("positionOffset", boundsMin);
+        }
+
+        // draw mesh. The VAO and textures stay bound, the next draw only rebinds what differs (see GLState).
+        state.BindVertexArray(VAO);
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+        glDrawElements(GL_TRIANGLES, lods[lod].indexCount, indexType, (void*)(lods[lod].indexOffset * indexSize));
+    }
+
+    // size of the GPU index buffer
+    size_t IndexBufferBytes() const
+    {
+        return indexCount * (indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int));
+    }
+
+private:
+    // render data
+    unsigned int VBO, EBO;
+
+    // sampler uniform of every texture (the N in diffuse_textureN counts per type), built when the textures or the
+    // prefix change so Draw doesn't put names together on every call
+    std::string glslIdentifierPrefix;
+    vector<string> samplerNames;
+    string packedName;
+    bool packed = false;
+
+    void resolveSamplerNames()
     {
-        // bind appropriate textures
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        unsigned int packedNr   = 1;
+        samplerNames.clear();
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -75,48 +286,89 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            else if(name == "texture_packed")
+                number = std::to_string(packedNr++);
+            samplerNames.push_back(glslIdentifierPrefix + name + number);
         }
-
-
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        packedName = glslIdentifierPrefix + "packed";
+        packed = packedNr > 1;
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
     {
+        this->vertexCount = (unsigned int)vertexCount;
+        this->indexCount = (unsigned int)indexCount;
+        if (lods.empty())
+            lods.push_back(MeshLod{0, (unsigned int)indexCount, 0.0f});
+        boundsMin = glm::vec3(0.0f);
+        boundsMax = glm::vec3(0.0f);
+        if (vertexCount > 0)
+        {
+            boundsMin = boundsMax = vertexData[0].Position;
+            for (size_t i = 1; i < vertexCount; i++)
+            {
+                boundsMin = glm::min(boundsMin, vertexData[i].Position);
+                boundsMax = glm::max(boundsMax, vertexData[i].Position);
+            }
+        }
+        // ratio of the UV area to the surface area, the square root of it is the average texture scale
+        float uvArea = 0.0f, area = 0.0f;
+        for (unsigned int i = lods[0].indexOffset; i + 2 < lods[0].indexOffset + lods[0].indexCount; i += 3)
+        {
+            const Vertex &a = vertexData[indexData[i]], &b = vertexData[indexData[i + 1]], &c = vertexData[indexData[i + 2]];
+            glm::vec2 du = b.TexCoords - a.TexCoords, dv = c.TexCoords - a.TexCoords;
+            uvArea += fabsf(du.x * dv.y - du.y * dv.x) * 0.5f;
+            area += glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position)) * 0.5f;
+        }
+        uvDensity = area > 0.0f ? sqrtf(uvArea / area) : 0.0f;
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        GLState::Instance().BindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        if (vertexFormat == VertexFormat::Compact)
+        {
+            vector<CompactVertex> compact(vertexCount);
+            for (size_t i = 0; i < vertexCount; i++)
+                compact[i] = CompressVertex(vertexData[i], boundsMin, boundsMax - boundsMin);
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(CompactVertex), compact.data(), GL_STATIC_DRAW);
+        }
+        else
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
 
+        // indices are kept as 32 bit on the CPU, but small meshes get a 16 bit index buffer on the GPU
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        if (vertexCount <= 65536)
+        {
+            indexType = GL_UNSIGNED_SHORT;
+            vector<uint16_t> shortIndices(indexData, indexData + indexCount);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+        }
+        else
+        {
+            indexType = GL_UNSIGNED_INT;
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+        }
 
         // set the vertex attribute pointers
+        if (vertexFormat == VertexFormat::Compact)
+            setupCompactAttributes();
+        else
+            setupFullAttributes();
+
+        GLState::Instance().BindVertexArray(0);
+    }
+
+    void setupFullAttributes()
+    {
         // vertex Positions
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
@@ -132,8 +384,22 @@ private:
         // vertex bitangent
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    }
 
-        glBindVertexArray(0);
+    void setupCompactAttributes()
+    {
+        // position (xyz) within the bounds + tangent handedness (w)
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Position));
+        // octahedral normal, decoded in the vertex shader
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, TexCoords));
+        // octahedral tangent, the bitangent is rebuilt from normal, tangent and handedness
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Tangent));
     }
 };
 #endif
\ No newline at end of file
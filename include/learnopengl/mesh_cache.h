@@ -0,0 +1,232 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/mesh.h>
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Binary cache of the final, GPU ready mesh data of a model. It sits next to the source file (backpack.obj ->
+// backpack.obj.meshcache) and is valid as long as the hash of the source file (which Model extends over an OBJ's
+// material libraries), the assimp import flags and the flags of the processing the model applies on top of assimp
+// match the ones stored in its header. The file is mmap'd on load and vertex/index data is handed to glBufferData
+// straight from the mapping, so a warm load does no parsing and no copying on the CPU.
+//
+// layout (all integers little endian, every block starts on a 4 byte boundary):
+//   MeshCacheHeader
+//   per mesh: MeshCacheMeshHeader, Vertex[vertexCount], unsigned int[indexCount], MeshLod[lodCount],
+//             per texture: uint32 typeLength, uint32 pathLength, type chars, path chars, padding to 4 bytes
+const uint32_t MESH_CACHE_VERSION = 3;
+
+struct MeshCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t vertexSize;   // sizeof(Vertex) when the file was written, guards against layout changes
+    uint64_t sourceHash;
+    uint32_t importFlags;
+    uint32_t processingFlags;
+    uint32_t meshCount;
+    uint32_t reserved;
+};
+
+struct MeshCacheMeshHeader {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+};
+
+// a mesh view into the mapped cache file, only valid while the owning MeshCache is alive
+struct CachedMesh {
+    const Vertex       *vertices;
+    uint32_t            vertexCount;
+    const unsigned int *indices;
+    uint32_t            indexCount;
+    vector<MeshLod>     lods;
+    vector<TextureRef>  textures;
+};
+
+class MeshCache
+{
+public:
+    // path of the cache file belonging to a model file
+    static string CachePath(const string &modelPath)
+    {
+        return modelPath + ".meshcache";
+    }
+
+    // 64 bit FNV-1a over the file contents, consumed a word at a time. Returns false if the file can't be read.
+    static bool HashFile(const string &path, uint64_t &hash)
+    {
+        MappedFile file;
+        if (!file.open(path))
+            return false;
+        const uint64_t prime = 0x100000001b3ULL;
+        hash = 0xcbf29ce484222325ULL;
+        const unsigned char *data = file.data();
+        size_t size = file.size();
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            hash = (hash ^ word) * prime;
+        }
+        for (; i < size; i++)
+            hash = (hash ^ data[i]) * prime;
+        hash = (hash ^ size) * prime;
+        return true;
+    }
+
+    // maps the cache file and checks that it was produced from the same source with the same import and processing
+    // flags. Returns false (and leaves the cache empty) when the file is missing, stale or malformed.
+    bool Open(const string &cachePath, uint64_t sourceHash, uint32_t importFlags, uint32_t processingFlags)
+    {
+        meshes.clear();
+        if (!file.open(cachePath))
+            return false;
+        if (!parse(sourceHash, importFlags, processingFlags))
+        {
+            meshes.clear();
+            file.close();
+            return false;
+        }
+        return true;
+    }
+
+    const vector<CachedMesh> &Meshes() const
+    {
+        return meshes;
+    }
+
+    // writes the CPU side data of the given meshes (Mesh or MeshData). The file is written under a temporary name
+    // and renamed, so a crash halfway through never leaves a truncated cache behind.
+    template <typename MeshType>
+    static bool Write(const string &cachePath, uint64_t sourceHash, uint32_t importFlags, uint32_t processingFlags,
+                      const vector<MeshType> &meshes)
+    {
+        string tmpPath = cachePath + ".tmp";
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if (!out)
+            return false;
+
+        MeshCacheHeader header;
+        memcpy(header.magic, "LOGLMSH", 8);
+        header.version = MESH_CACHE_VERSION;
+        header.vertexSize = sizeof(Vertex);
+        header.sourceHash = sourceHash;
+        header.importFlags = importFlags;
+        header.processingFlags = processingFlags;
+        header.meshCount = (uint32_t)meshes.size();
+        header.reserved = 0;
+        out.write((const char *)&header, sizeof(header));
+
+        static const char padding[4] = {0, 0, 0, 0};
+        for (const MeshType &mesh : meshes)
+        {
+            MeshCacheMeshHeader meshHeader;
+            meshHeader.vertexCount = (uint32_t)mesh.vertices.size();
+            meshHeader.indexCount = (uint32_t)mesh.indices.size();
+            meshHeader.textureCount = (uint32_t)mesh.textures.size();
+            meshHeader.lodCount = (uint32_t)mesh.lods.size();
+            out.write((const char *)&meshHeader, sizeof(meshHeader));
+            out.write((const char *)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            out.write((const char *)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+            out.write((const char *)mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+            for (const auto &texture : mesh.textures)
+            {
+                uint32_t lengths[2] = {(uint32_t)texture.type.size(), (uint32_t)texture.path.size()};
+                out.write((const char *)lengths, sizeof(lengths));
+                out.write(texture.type.data(), lengths[0]);
+                out.write(texture.path.data(), lengths[1]);
+                out.write(padding, (4 - (lengths[0] + lengths[1]) % 4) % 4);
+            }
+        }
+        out.close();
+        if (!out)
+        {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return rename(tmpPath.c_str(), cachePath.c_str()) == 0;
+    }
+
+private:
+    MappedFile file;
+    vector<CachedMesh> meshes;
+
+    bool parse(uint64_t sourceHash, uint32_t importFlags, uint32_t processingFlags)
+    {
+        const unsigned char *data = file.data();
+        size_t size = file.size();
+        size_t offset = 0;
+
+        if (size < sizeof(MeshCacheHeader))
+            return false;
+        MeshCacheHeader header;
+        memcpy(&header, data, sizeof(header));
+        offset += sizeof(header);
+        if (memcmp(header.magic, "LOGLMSH", 8) != 0 || header.version != MESH_CACHE_VERSION ||
+            header.vertexSize != sizeof(Vertex) || header.sourceHash != sourceHash || header.importFlags != importFlags ||
+            header.processingFlags != processingFlags)
+            return false;
+
+        meshes.reserve(header.meshCount);
+        for (uint32_t m = 0; m < header.meshCount; m++)
+        {
+            if (size - offset < sizeof(MeshCacheMeshHeader))
+                return false;
+            MeshCacheMeshHeader meshHeader;
+            memcpy(&meshHeader, data + offset, sizeof(meshHeader));
+            offset += sizeof(meshHeader);
+
+            size_t vertexBytes = (size_t)meshHeader.vertexCount * sizeof(Vertex);
+            size_t indexBytes = (size_t)meshHeader.indexCount * sizeof(unsigned int);
+            size_t lodBytes = (size_t)meshHeader.lodCount * sizeof(MeshLod);
+            if (size - offset < vertexBytes + indexBytes + lodBytes)
+                return false;
+
+            CachedMesh mesh;
+            mesh.vertices = reinterpret_cast<const Vertex *>(data + offset);
+            mesh.vertexCount = meshHeader.vertexCount;
+            offset += vertexBytes;
+            mesh.indices = reinterpret_cast<const unsigned int *>(data + offset);
+            mesh.indexCount = meshHeader.indexCount;
+            offset += indexBytes;
+            const MeshLod *lods = reinterpret_cast<const MeshLod *>(data + offset);
+            mesh.lods.assign(lods, lods + meshHeader.lodCount);
+            offset += lodBytes;
+            for (const MeshLod &lod : mesh.lods)
+                if ((uint64_t)lod.indexOffset + lod.indexCount > mesh.indexCount)
+                    return false;
+
+            for (uint32_t t = 0; t < meshHeader.textureCount; t++)
+            {
+                uint32_t lengths[2];
+                if (size - offset < sizeof(lengths))
+                    return false;
+                memcpy(lengths, data + offset, sizeof(lengths));
+                offset += sizeof(lengths);
+                size_t stringBytes = (size_t)lengths[0] + lengths[1];
+                size_t paddedBytes = stringBytes + (4 - stringBytes % 4) % 4;
+                if (size - offset < paddedBytes)
+                    return false;
+                TextureRef ref;
+                ref.type.assign((const char *)data + offset, lengths[0]);
+                ref.path.assign((const char *)data + offset + lengths[0], lengths[1]);
+                mesh.textures.push_back(ref);
+                offset += paddedBytes;
+            }
+            meshes.push_back(mesh);
+        }
+        return true;
+    }
+};
+
+#endif
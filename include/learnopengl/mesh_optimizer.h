@@ -0,0 +1,266 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// Import time reordering of triangle lists. All functions work on plain triangle lists (3 indices per triangle) and
+// keep the set of triangles intact, only their order (and for OptimizeVertexFetch the vertex order) changes.
+// The usual order of application is OptimizeVertexCache, OptimizeOverdraw, OptimizeVertexFetch.
+
+// average number of vertex shader invocations per triangle for a FIFO post-transform cache of the given size.
+// 3.0 is the worst case, 0.5 the theoretical best for large regular meshes.
+inline float ComputeACMR(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = 16)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+    // a vertex is in a FIFO cache while fewer than cacheSize other vertices entered the cache after it
+    vector<unsigned int> enteredAt(vertexCount, 0);
+    unsigned int timestamp = cacheSize + 1;
+    size_t misses = 0;
+    for (unsigned int index : indices)
+    {
+        if (timestamp - enteredAt[index] > cacheSize)
+        {
+            enteredAt[index] = timestamp++;
+            misses++;
+        }
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+// Tom Forsyth's "Linear-Speed Vertex Cache Optimisation": greedily emits the triangle whose vertices score best for
+// an LRU cache model, favouring vertices that are in the cache and vertices with few triangles left to emit.
+inline void OptimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount)
+{
+    const int cacheSize = 32;
+    const float decayPower = 1.5f;
+    const float lastTriangleScore = 0.75f;
+    const float valenceBoostScale = 2.0f;
+    const float valenceBoostPower = 0.5f;
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    auto vertexScore = [&](int cachePosition, unsigned int activeTriangles) {
+        if (activeTriangles == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+                score = lastTriangleScore; // the vertices of the last triangle get a fixed score, they'd be hit anyway
+            else
+                score = powf(1.0f - (float)(cachePosition - 3) / (float)(cacheSize - 3), decayPower);
+        }
+        return score + valenceBoostScale * powf((float)activeTriangles, -valenceBoostPower);
+    };
+
+    // vertex -> triangles adjacency, the first activeTriangles[v] entries of each list are the not yet emitted ones
+    vector<unsigned int> activeTriangles(vertexCount, 0);
+    for (unsigned int index : indices)
+        activeTriangles[index]++;
+    vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + activeTriangles[v];
+    vector<unsigned int> adjacency(indices.size());
+    {
+        vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+    }
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, activeTriangles[v]);
+    vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+    vector<bool> emitted(triangleCount, false);
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    vector<unsigned int> cache, newCache;
+    cache.reserve(cacheSize + 3);
+    newCache.reserve(cacheSize + 3);
+    size_t nextUnemitted = 0;
+    long best = -1;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        if (best < 0)
+        {
+            // nothing adjacent to the cache is left, continue with the next triangle in input order
+            while (emitted[nextUnemitted])
+                nextUnemitted++;
+            best = (long)nextUnemitted;
+        }
+
+        const unsigned int *triangle = &indices[best * 3];
+        emitted[best] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // remove the triangle from the adjacency of its vertices
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = triangle[k];
+            unsigned int *list = &adjacency[adjacencyOffset[v]];
+            for (unsigned int i = 0; i < activeTriangles[v]; i++)
+            {
+                if (list[i] == (unsigned int)best)
+                {
+                    std::swap(list[i], list[activeTriangles[v] - 1]);
+                    break;
+                }
+            }
+            activeTriangles[v]--;
+        }
+
+        // the triangle's vertices move to the front of the LRU cache
+        newCache.assign(triangle, triangle + 3);
+        for (unsigned int v : cache)
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache.push_back(v);
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < (size_t)cacheSize ? (int)i : -1;
+            score[v] = vertexScore(cachePosition[v], activeTriangles[v]);
+        }
+
+        // rescore the remaining triangles touching the cache (and the vertices that just dropped out of it), the
+        // next triangle is the best one that has a vertex in the cache
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : newCache)
+        {
+            for (unsigned int i = 0; i < activeTriangles[v]; i++)
+            {
+                unsigned int t = adjacency[adjacencyOffset[v] + i];
+                triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+                if (cachePosition[v] >= 0 && triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        if (newCache.size() > (size_t)cacheSize)
+            newCache.resize(cacheSize);
+        cache.swap(newCache);
+    }
+    indices.swap(result);
+}
+
+// Reduces overdraw by drawing outward facing parts of the mesh first (Sander et al. "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw"). The triangle list is cut into clusters at the points where the vertex cache
+// starts over anyway (all three vertices miss), so the reorder costs almost nothing in cache efficiency, and the
+// clusters are sorted by how far they face away from the mesh center. Expects vertex cache optimized input.
+inline void OptimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices, unsigned int cacheSize = 16,
+                      size_t minClusterTriangles = 32)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2 * minClusterTriangles)
+        return;
+
+    // cluster boundaries
+    vector<size_t> clusterStart;
+    vector<unsigned int> enteredAt(vertices.size(), 0);
+    unsigned int timestamp = cacheSize + 1;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        int misses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = indices[t * 3 + k];
+            if (timestamp - enteredAt[v] > cacheSize)
+            {
+                enteredAt[v] = timestamp++;
+                misses++;
+            }
+        }
+        if (clusterStart.empty() || (misses == 3 && t - clusterStart.back() >= minClusterTriangles))
+            clusterStart.push_back(t);
+    }
+    if (clusterStart.size() < 2)
+        return;
+    clusterStart.push_back(triangleCount);
+
+    // area weighted centroid and normal of every cluster and of the whole mesh
+    size_t clusterCount = clusterStart.size() - 1;
+    vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+    vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        float clusterArea = 0.0f;
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].Position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &d = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float area = glm::length(normal);
+            clusterCentroid[c] += (a + b + d) * (area / 3.0f);
+            clusterNormal[c] += normal;
+            clusterArea += area;
+        }
+        meshCentroid += clusterCentroid[c];
+        meshArea += clusterArea;
+        if (clusterArea > 0.0f)
+            clusterCentroid[c] /= clusterArea;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // clusters facing away from the center are likely occluders of the ones facing inward, draw them first
+    vector<float> sortKey(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        float length = glm::length(clusterNormal[c]);
+        sortKey[c] = length > 0.0f ? glm::dot(clusterCentroid[c] - meshCentroid, clusterNormal[c] / length) : 0.0f;
+    }
+    vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+        order[c] = c;
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c : order)
+        result.insert(result.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+    indices.swap(result);
+}
+
+// reorders vertices in the order the index buffer first references them, so vertex fetch walks memory linearly.
+// Vertices no triangle references are dropped.
+inline void OptimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    const unsigned int unused = ~0u;
+    vector<unsigned int> remap(vertices.size(), unused);
+    vector<Vertex> result;
+    result.reserve(vertices.size());
+    for (unsigned int &index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = (unsigned int)result.size();
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(result);
+}
+
+#endif
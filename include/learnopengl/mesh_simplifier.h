@@ -0,0 +1,485 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Import time simplification of triangle lists for LODs, after Garland and Heckbert's "Surface Simplification Using
+// Quadric Error Metrics". Edges are collapsed onto one of their end vertices, never onto a new position, so a
+// simplified index list still references the vertices of the original mesh and every LOD of a mesh can be drawn
+// from the same vertex buffer.
+//
+// Collapses are decided on positions, with vertices that share a position (UV or normal seams) moving together: every
+// vertex at the collapsed position has to map onto the vertex at the target position it shares an edge with, which
+// keeps seams intact. The cost of a collapse is the quadric error of the position move plus a penalty for the change
+// of normal and uv the move causes, so the attributes stay as close as possible to the original.
+class MeshSimplifier
+{
+public:
+    // collapses edges until the index list is down to targetIndexCount or the next collapse would cost more than
+    // maxError. Returns the new index list. Errors are relative to the mesh extent (1 = the size of the mesh), error
+    // receives the largest one of the collapses done.
+    static vector<unsigned int> Simplify(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+                                         size_t targetIndexCount, float maxError, float *error = nullptr)
+    {
+        if (error)
+            *error = 0.0f;
+        vector<unsigned int> result(indices);
+        if (vertices.empty() || result.size() <= targetIndexCount)
+            return result;
+
+        // positions scaled into the unit cube, so errors are relative to the mesh size
+        glm::vec3 boundsMin = vertices[0].Position, boundsMax = vertices[0].Position;
+        for (const Vertex &vertex : vertices)
+        {
+            boundsMin = glm::min(boundsMin, vertex.Position);
+            boundsMax = glm::max(boundsMax, vertex.Position);
+        }
+        glm::vec3 size = boundsMax - boundsMin;
+        float extent = max(size.x, max(size.y, size.z));
+        if (extent <= 0.0f)
+            return result;
+
+        Context context(vertices);
+        for (size_t i = 0; i < vertices.size(); i++)
+            context.positions[i] = (vertices[i].Position - boundsMin) / extent;
+        context.buildPositionIds();
+        removeDegenerateTriangles(context, result);
+        context.buildQuadrics(result);
+
+        float errorLimit = maxError * maxError;
+        float largestError = 0.0f;
+        vector<unsigned int> remap(vertices.size());
+        while (result.size() > targetIndexCount)
+        {
+            context.buildTopology(result);
+            vector<Collapse> collapses = findCollapses(context, result, errorLimit);
+            sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.error < b.error; });
+
+            // a collapse changes the triangles around the collapsed position, so collapses done in the same pass
+            // must not touch those triangles or the target position
+            for (size_t i = 0; i < remap.size(); i++)
+                remap[i] = (unsigned int)i;
+            vector<bool> touched(context.positionCount, false);
+            size_t triangleGoal = (result.size() - targetIndexCount) / 3;
+            size_t removed = 0, collapsed = 0;
+            for (const Collapse &collapse : collapses)
+            {
+                if (removed >= triangleGoal)
+                    break;
+                if (touched[collapse.from] || touched[collapse.to])
+                    continue;
+                for (const pair<unsigned int, unsigned int> &wedge : context.pairWedges(result, collapse.from, collapse.to))
+                    remap[wedge.first] = wedge.second;
+                context.quadrics[collapse.to].add(context.quadrics[collapse.from]);
+
+                for (unsigned int t : context.trianglesAround(collapse.from))
+                {
+                    bool hasTarget = false;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        unsigned int position = context.positionId[result[t * 3 + k]];
+                        touched[position] = true;
+                        hasTarget = hasTarget || position == collapse.to;
+                    }
+                    if (hasTarget)
+                        removed++;
+                }
+                touched[collapse.to] = true;
+                largestError = max(largestError, collapse.error);
+                collapsed++;
+            }
+            if (collapsed == 0)
+                break;
+
+            for (unsigned int &index : result)
+                index = remap[index];
+            removeDegenerateTriangles(context, result);
+        }
+
+        if (error)
+            *error = sqrtf(largestError);
+        return result;
+    }
+
+    // appends a chain of LODs, each about half the triangles of the one before, to the index list of a mesh. lods
+    // receives one entry per level, LOD 0 being the original indices, with errors in model space units. Levels stop
+    // when the simplification stalls, the error limit is hit or the mesh gets below minTriangles.
+    static void BuildLods(const vector<Vertex> &vertices, vector<unsigned int> &indices, vector<MeshLod> &lods,
+                          unsigned int maxLods = 5, size_t minTriangles = 64, float maxError = 0.1f)
+    {
+        lods.assign(1, MeshLod{0, (unsigned int)indices.size(), 0.0f});
+        if (vertices.empty())
+            return;
+        glm::vec3 boundsMin = vertices[0].Position, boundsMax = vertices[0].Position;
+        for (const Vertex &vertex : vertices)
+        {
+            boundsMin = glm::min(boundsMin, vertex.Position);
+            boundsMax = glm::max(boundsMax, vertex.Position);
+        }
+        glm::vec3 size = boundsMax - boundsMin;
+        float extent = max(size.x, max(size.y, size.z));
+
+        vector<unsigned int> current(indices);
+        float error = 0.0f;
+        while (lods.size() < maxLods && current.size() / 3 > minTriangles)
+        {
+            float levelError;
+            size_t target = current.size() / 6 * 3;
+            vector<unsigned int> simplified = Simplify(vertices, current, target, maxError, &levelError);
+            // a level that barely saves anything isn't worth its index buffer space
+            if (simplified.size() * 5 > current.size() * 4)
+                break;
+            OptimizeVertexCache(simplified, vertices.size());
+            // every level is simplified from the one before, its error adds up on top of theirs
+            error += levelError * extent;
+            lods.push_back(MeshLod{(unsigned int)indices.size(), (unsigned int)simplified.size(), error});
+            indices.insert(indices.end(), simplified.begin(), simplified.end());
+            current.swap(simplified);
+        }
+    }
+
+private:
+    // squared distance to a set of area weighted planes, divided by the total weight
+    struct Quadric {
+        double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+        double b0 = 0, b1 = 0, b2 = 0;
+        double c = 0;
+        double weight = 0;
+
+        void addPlane(const glm::vec3 &normal, float distance, float planeWeight)
+        {
+            double w = planeWeight;
+            a00 += w * normal.x * normal.x;
+            a11 += w * normal.y * normal.y;
+            a22 += w * normal.z * normal.z;
+            a01 += w * normal.x * normal.y;
+            a02 += w * normal.x * normal.z;
+            a12 += w * normal.y * normal.z;
+            b0 += w * normal.x * distance;
+            b1 += w * normal.y * distance;
+            b2 += w * normal.z * distance;
+            c += w * distance * distance;
+            weight += w;
+        }
+
+        void add(const Quadric &other)
+        {
+            a00 += other.a00; a11 += other.a11; a22 += other.a22;
+            a01 += other.a01; a02 += other.a02; a12 += other.a12;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+        }
+
+        float evaluate(const glm::vec3 &v) const
+        {
+            double x = v.x, y = v.y, z = v.z;
+            double error = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                           2 * (b0 * x + b1 * y + b2 * z) + c;
+            return weight > 0 ? (float)max(error / weight, 0.0) : 0.0f;
+        }
+    };
+
+    struct Collapse {
+        unsigned int from; // position ids
+        unsigned int to;
+        float error;
+    };
+
+    struct Context {
+        const vector<Vertex> &vertices;
+        vector<glm::vec3> positions;        // per vertex, normalized
+        vector<unsigned int> positionId;    // per vertex, vertices at the same position share an id
+        size_t positionCount = 0;
+        vector<Quadric> quadrics;           // per position id
+
+        // per pass: triangles around every position (CSR) and directed edge counts between positions
+        vector<unsigned int> triangleOffset;
+        vector<unsigned int> triangles;
+        unordered_map<uint64_t, unsigned int> edges;
+        vector<bool> border;
+        vector<bool> locked;
+
+        explicit Context(const vector<Vertex> &vertices) : vertices(vertices), positions(vertices.size()) {}
+
+        void buildPositionIds()
+        {
+            vector<unsigned int> order(vertices.size());
+            for (size_t i = 0; i < order.size(); i++)
+                order[i] = (unsigned int)i;
+            auto less = [this](unsigned int a, unsigned int b) {
+                const glm::vec3 &pa = vertices[a].Position, &pb = vertices[b].Position;
+                if (pa.x != pb.x)
+                    return pa.x < pb.x;
+                if (pa.y != pb.y)
+                    return pa.y < pb.y;
+                return pa.z < pb.z;
+            };
+            sort(order.begin(), order.end(), less);
+            positionId.resize(vertices.size());
+            positionCount = 0;
+            for (size_t i = 0; i < order.size(); i++)
+            {
+                if (i > 0 && less(order[i - 1], order[i]))
+                    positionCount++;
+                positionId[order[i]] = (unsigned int)positionCount;
+            }
+            positionCount++;
+        }
+
+        static uint64_t edgeKey(unsigned int a, unsigned int b)
+        {
+            return ((uint64_t)a << 32) | b;
+        }
+
+        bool hasEdge(unsigned int a, unsigned int b) const
+        {
+            return edges.count(edgeKey(a, b)) != 0;
+        }
+
+        void buildQuadrics(const vector<unsigned int> &indices)
+        {
+            // plane of every triangle, weighted by its area
+            quadrics.assign(positionCount, Quadric());
+            buildEdges(indices);
+            for (size_t t = 0; t < indices.size() / 3; t++)
+            {
+                const glm::vec3 &a = positions[indices[t * 3]];
+                const glm::vec3 &b = positions[indices[t * 3 + 1]];
+                const glm::vec3 &c = positions[indices[t * 3 + 2]];
+                glm::vec3 normal = glm::cross(b - a, c - a);
+                float area = glm::length(normal);
+                if (area <= 0.0f)
+                    continue;
+                normal /= area;
+                for (int k = 0; k < 3; k++)
+                    quadrics[positionId[indices[t * 3 + k]]].addPlane(normal, -glm::dot(normal, a), area);
+
+                // open edges additionally get a plane through the edge, perpendicular to the triangle, which keeps
+                // the outline of the mesh in place
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int from = indices[t * 3 + k], to = indices[t * 3 + (k + 1) % 3];
+                    if (hasEdge(positionId[to], positionId[from]))
+                        continue;
+                    glm::vec3 edge = positions[to] - positions[from];
+                    float length = glm::length(edge);
+                    if (length <= 0.0f)
+                        continue;
+                    glm::vec3 borderNormal = glm::cross(edge / length, normal);
+                    float weight = length * length * 10.0f;
+                    quadrics[positionId[from]].addPlane(borderNormal, -glm::dot(borderNormal, positions[from]), weight);
+                    quadrics[positionId[to]].addPlane(borderNormal, -glm::dot(borderNormal, positions[to]), weight);
+                }
+            }
+        }
+
+        void buildEdges(const vector<unsigned int> &indices)
+        {
+            edges.clear();
+            edges.reserve(indices.size());
+            for (size_t t = 0; t < indices.size() / 3; t++)
+                for (int k = 0; k < 3; k++)
+                    edges[edgeKey(positionId[indices[t * 3 + k]], positionId[indices[t * 3 + (k + 1) % 3]])]++;
+        }
+
+        void buildTopology(const vector<unsigned int> &indices)
+        {
+            buildEdges(indices);
+            triangleOffset.assign(positionCount + 1, 0);
+            for (unsigned int index : indices)
+                triangleOffset[positionId[index] + 1]++;
+            for (size_t p = 0; p < positionCount; p++)
+                triangleOffset[p + 1] += triangleOffset[p];
+            triangles.resize(indices.size());
+            vector<unsigned int> fill(triangleOffset.begin(), triangleOffset.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++)
+                triangles[fill[positionId[indices[i]]]++] = (unsigned int)(i / 3);
+
+            // positions on an open edge can only move along it, positions on non manifold edges can't move at all
+            border.assign(positionCount, false);
+            locked.assign(positionCount, false);
+            for (const auto &edge : edges)
+            {
+                unsigned int a = (unsigned int)(edge.first >> 32), b = (unsigned int)(edge.first & 0xffffffffu);
+                if (edge.second > 1)
+                    locked[a] = locked[b] = true;
+                if (!hasEdge(b, a))
+                    border[a] = border[b] = true;
+            }
+        }
+
+        struct TriangleRange {
+            const unsigned int *first, *last;
+            const unsigned int *begin() const { return first; }
+            const unsigned int *end() const { return last; }
+        };
+
+        TriangleRange trianglesAround(unsigned int position) const
+        {
+            return TriangleRange{triangles.data() + triangleOffset[position], triangles.data() + triangleOffset[position + 1]};
+        }
+
+        // for a collapse of position from onto position to: the vertex at to that every vertex at from moves onto.
+        // Empty if a vertex at from shares no edge with a vertex at to, or edges with several.
+        vector<pair<unsigned int, unsigned int>> pairWedges(const vector<unsigned int> &indices, unsigned int from,
+                                                            unsigned int to) const
+        {
+            vector<pair<unsigned int, unsigned int>> wedges;
+            vector<unsigned int> unpaired;
+            for (unsigned int t : trianglesAround(from))
+            {
+                unsigned int fromVertex = 0, toVertex = 0;
+                bool hasTo = false;
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int vertex = indices[t * 3 + k];
+                    if (positionId[vertex] == from)
+                        fromVertex = vertex;
+                    else if (positionId[vertex] == to)
+                    {
+                        toVertex = vertex;
+                        hasTo = true;
+                    }
+                }
+                if (!hasTo)
+                {
+                    unpaired.push_back(fromVertex);
+                    continue;
+                }
+                bool known = false;
+                for (const pair<unsigned int, unsigned int> &wedge : wedges)
+                {
+                    if (wedge.first != fromVertex)
+                        continue;
+                    if (wedge.second != toVertex)
+                        return vector<pair<unsigned int, unsigned int>>();
+                    known = true;
+                }
+                if (!known)
+                    wedges.push_back(make_pair(fromVertex, toVertex));
+            }
+            for (unsigned int vertex : unpaired)
+            {
+                bool paired = false;
+                for (const pair<unsigned int, unsigned int> &wedge : wedges)
+                    paired = paired || wedge.first == vertex;
+                if (!paired)
+                    return vector<pair<unsigned int, unsigned int>>();
+            }
+            return wedges;
+        }
+    };
+
+    static void removeDegenerateTriangles(const Context &context, vector<unsigned int> &indices)
+    {
+        size_t kept = 0;
+        for (size_t t = 0; t < indices.size() / 3; t++)
+        {
+            unsigned int a = context.positionId[indices[t * 3]];
+            unsigned int b = context.positionId[indices[t * 3 + 1]];
+            unsigned int c = context.positionId[indices[t * 3 + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            for (int k = 0; k < 3; k++)
+                indices[kept++] = indices[t * 3 + k];
+        }
+        indices.resize(kept);
+    }
+
+    // cost of moving the vertices at position from onto the ones at position to, negative if the collapse isn't
+    // allowed: it would tear a seam, move an open edge inward or flip a triangle
+    static float collapseError(const Context &context, const vector<unsigned int> &indices, unsigned int from,
+                               unsigned int to, bool borderEdge)
+    {
+        if (context.locked[from] || (context.border[from] && !borderEdge))
+            return -1.0f;
+        vector<pair<unsigned int, unsigned int>> wedges = context.pairWedges(indices, from, to);
+        if (wedges.empty())
+            return -1.0f;
+
+        const glm::vec3 &target = context.positions[wedges[0].second];
+        for (unsigned int t : context.trianglesAround(from))
+        {
+            glm::vec3 corners[3];
+            glm::vec3 moved[3];
+            bool hasTo = false;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int vertex = indices[t * 3 + k];
+                corners[k] = moved[k] = context.positions[vertex];
+                if (context.positionId[vertex] == from)
+                    moved[k] = target;
+                hasTo = hasTo || context.positionId[vertex] == to;
+            }
+            if (hasTo)
+                continue; // collapses away
+            glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+            glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+            if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+                return -1.0f;
+        }
+
+        // attribute change, weighted so that turning a normal by 90 degrees costs about as much as moving the
+        // surface by 5% of the mesh size, and shifting uvs by 0.1 as much as moving it by 2%
+        const float normalWeight = 0.00125f;
+        const float uvWeight = 0.04f;
+        float attributeError = 0.0f;
+        for (const pair<unsigned int, unsigned int> &wedge : wedges)
+        {
+            const Vertex &a = context.vertices[wedge.first];
+            const Vertex &b = context.vertices[wedge.second];
+            glm::vec3 normal = a.Normal - b.Normal;
+            glm::vec2 uv = a.TexCoords - b.TexCoords;
+            attributeError = max(attributeError, normalWeight * glm::dot(normal, normal) + uvWeight * glm::dot(uv, uv));
+        }
+        // the merged position carries the planes of both ends, after earlier collapses the ones to has gathered no
+        // longer pass through it, so leaving them out would underestimate the error (Garland and Heckbert's Q1 + Q2)
+        Quadric merged = context.quadrics[from];
+        merged.add(context.quadrics[to]);
+        return merged.evaluate(target) + attributeError;
+    }
+
+    // the cheaper allowed direction of every edge whose cost is within errorLimit
+    static vector<Collapse> findCollapses(const Context &context, const vector<unsigned int> &indices, float errorLimit)
+    {
+        vector<Collapse> collapses;
+        for (size_t t = 0; t < indices.size() / 3; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = context.positionId[indices[t * 3 + k]];
+                unsigned int b = context.positionId[indices[t * 3 + (k + 1) % 3]];
+                bool borderEdge = !context.hasEdge(b, a);
+                // interior edges are seen from both of their triangles, only look at them once
+                if (!borderEdge && a > b)
+                    continue;
+                float errorAB = collapseError(context, indices, a, b, borderEdge);
+                float errorBA = collapseError(context, indices, b, a, borderEdge);
+                Collapse collapse;
+                if (errorAB >= 0.0f && (errorBA < 0.0f || errorAB <= errorBA))
+                    collapse = Collapse{a, b, errorAB};
+                else if (errorBA >= 0.0f)
+                    collapse = Collapse{b, a, errorBA};
+                else
+                    continue;
+                if (collapse.error <= errorLimit)
+                    collapses.push_back(collapse);
+            }
+        }
+        return collapses;
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef MIP_CHAIN_H
+#define MIP_CHAIN_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIP_CHAIN_SSE2 1
+#endif
+
+// CPU generation of the mip chain of an 8 bit image with a 2x2 box filter. Color images are filtered in linear light:
+// their RGB channels are sRGB encoded, and averaging the encoded values (what glGenerateMipmap on a GL_RGB texture
+// does) darkens every edge between light and dark texels in the smaller levels. Alpha and the channels of one and two
+// channel images (masks, roughness, ...) hold linear data and are averaged as they are, so are all channels when
+// srgb is false (normal and height maps).
+//
+// Texels are converted to 12 bit linear values through a table, the 2x2 sums are done with SSE2 on 8 values (two
+// texels of four channels) at a time and converted back through a second table. No GL dependency, tools use it too.
+
+// conversion tables between 8 bit texels and 12 bit linear values for one kind of channel
+struct MipChannelTables {
+    uint16_t toLinear[256];
+    uint8_t fromLinear[4096];
+};
+
+inline const MipChannelTables &MipChainTables(bool srgb)
+{
+    struct Tables {
+        MipChannelTables srgb, linear;
+        Tables()
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                float c = i / 255.0f;
+                float l = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+                srgb.toLinear[i] = (uint16_t)(l * 4095.0f + 0.5f);
+                linear.toLinear[i] = (uint16_t)(c * 4095.0f + 0.5f);
+            }
+            for (int i = 0; i < 4096; i++)
+            {
+                float l = i / 4095.0f;
+                float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+                srgb.fromLinear[i] = (uint8_t)(c * 255.0f + 0.5f);
+                linear.fromLinear[i] = (uint8_t)(l * 255.0f + 0.5f);
+            }
+        }
+    };
+    static const Tables tables;
+    return srgb ? tables.srgb : tables.linear;
+}
+
+// number of levels of a full chain down to 1x1, level 0 included
+inline int MipLevelCount(int width, int height)
+{
+    int levels = 1;
+    while (width > 1 || height > 1)
+    {
+        width = max(1, width / 2);
+        height = max(1, height / 2);
+        levels++;
+    }
+    return levels;
+}
+
+// next level of the chain. Sizes are halved and rounded down, so the last row/column of an odd sized level is
+// dropped. channels is 1 to 4, srgb tells whether RGB of 3 and 4 channel images is sRGB encoded.
+inline vector<uint8_t> DownsampleMipLevel(const uint8_t *texels, int width, int height, int channels, bool srgb,
+                                   int &nextWidth, int &nextHeight)
+{
+    nextWidth = max(1, width / 2);
+    nextHeight = max(1, height / 2);
+    vector<uint8_t> result((size_t)nextWidth * nextHeight * channels);
+
+    const MipChannelTables *tables[4];
+    for (int c = 0; c < 4; c++)
+        tables[c] = &MipChainTables(srgb && channels >= 3 && c < 3);
+
+    // two source rows as 12 bit linear values, always four per texel and 2 * nextWidth texels wide (a single column
+    // is repeated), so every output texel is the sum of two neighbouring 8 byte texels in both rows
+    int rowTexels = nextWidth * 2;
+    vector<uint16_t> rows[2];
+    rows[0].assign((size_t)rowTexels * 4, 0);
+    rows[1].assign((size_t)rowTexels * 4, 0);
+    vector<uint16_t> sums((size_t)nextWidth * 4 + 4);
+    for (int y = 0; y < nextHeight; y++)
+    {
+        for (int r = 0; r < 2; r++)
+        {
+            const uint8_t *row = texels + (size_t)min(y * 2 + r, height - 1) * width * channels;
+            uint16_t *linear = rows[r].data();
+            for (int x = 0; x < rowTexels; x++)
+            {
+                const uint8_t *texel = row + (size_t)min(x, width - 1) * channels;
+                for (int c = 0; c < channels; c++)
+                    linear[x * 4 + c] = tables[c]->toLinear[texel[c]];
+            }
+        }
+
+        const uint16_t *top = rows[0].data(), *bottom = rows[1].data();
+        int x = 0;
+#ifdef MIP_CHAIN_SSE2
+        // two output texels per iteration: four source texels of each row, added vertically, then pairwise
+        const __m128i rounding = _mm_set1_epi16(2);
+        for (; x + 2 <= nextWidth; x += 2)
+        {
+            __m128i a = _mm_add_epi16(_mm_loadu_si128((const __m128i *)(top + x * 8)),
+                                      _mm_loadu_si128((const __m128i *)(bottom + x * 8)));
+            __m128i b = _mm_add_epi16(_mm_loadu_si128((const __m128i *)(top + x * 8 + 8)),
+                                      _mm_loadu_si128((const __m128i *)(bottom + x * 8 + 8)));
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+            _mm_storeu_si128((__m128i *)(sums.data() + x * 4), _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2));
+        }
+#endif
+        for (; x < nextWidth; x++)
+            for (int c = 0; c < 4; c++)
+                sums[x * 4 + c] = (uint16_t)((top[x * 8 + c] + top[x * 8 + 4 + c] + bottom[x * 8 + c] +
+                                              bottom[x * 8 + 4 + c] + 2) >> 2);
+
+        uint8_t *out = result.data() + (size_t)y * nextWidth * channels;
+        for (x = 0; x < nextWidth; x++)
+            for (int c = 0; c < channels; c++)
+                out[x * channels + c] = tables[c]->fromLinear[sums[x * 4 + c]];
+    }
+    return result;
+}
+
+// levels 1 and up of the chain of an image down to 1x1, each one filtered from the one before
+inline vector<vector<uint8_t>> BuildMipChain(const uint8_t *texels, int width, int height, int channels, bool srgb)
+{
+    vector<vector<uint8_t>> levels;
+    const uint8_t *level = texels;
+    while (width > 1 || height > 1)
+    {
+        levels.push_back(DownsampleMipLevel(level, width, height, channels, srgb, width, height));
+        level = levels.back().data();
+    }
+    return levels;
+}
+
+#endif
@@ -10,70 +10,670 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/camera.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/obj_loader.h>
 #include <learnopengl/shader.h>
-
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/texture_uploader.h>
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <limits>
+#include <memory>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+// gamma: the texture holds sRGB colors (a diffuse map), its mip chain is filtered in linear space, see mip_chain.h
+inline unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+
+// post processing applied by assimp on import. They are part of the mesh cache key, changing them invalidates the cache.
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+// processing the model does on top of assimp, also part of the mesh cache key
+const unsigned int MODEL_PROCESS_OPTIMIZE = 1 << 0;
+const unsigned int MODEL_PROCESS_NATIVE_OBJ = 1 << 1;
+const unsigned int MODEL_PROCESS_LODS = 1 << 2;
+
+// knobs for how a model gets loaded
+struct ModelLoadOptions {
+    bool gammaCorrection = false;
+    // collect the textures of all meshes first and decode them on worker threads, only the GL uploads stay on the
+    // calling (context) thread. Otherwise every texture is decoded and uploaded as soon as a mesh references it.
+    bool parallelTextureDecode = false;
+    // keep the CPU copy of every mesh's vertices and indices after they are uploaded. By default they are freed
+    // and only counts and bounds stay around, so a loaded model costs about as much memory as its GPU buffers.
+    bool retainGeometry = false;
+    // upload vertices in the 20 byte CompactVertex layout, needs 2.model_lighting_compact.vs (or another shader
+    // with the same decode) instead of the float attribute vertex shaders
+    bool compactVertices = false;
+    // reorder triangles and vertices of every mesh for vertex cache hits, less overdraw and linear vertex fetch
+    bool optimizeMeshes = false;
+    // build a chain of simplified LODs for every mesh, picked by Model::Draw overload taking the camera
+    bool generateLods = false;
+    // import .obj files with the built in ObjLoader instead of assimp, assimp is still used if it fails
+    bool nativeObjLoader = false;
+    // return from the constructor right away: the file is imported and its textures decoded on a worker thread, and
+    // the GL objects are created a few at a time by Model::Update on the render thread. The model draws nothing
+    // until IsReady().
+    bool asyncLoad = false;
+};
+
+// where an asynchronous load is at, done and total count the units of work of the current stage
+struct ModelLoadProgress {
+    const char *stage;
+    size_t done;
+    size_t total;
+};
+
+// totals over all meshes of the import time optimization, for reporting
+struct ModelOptimizeStats {
+    double missesBefore = 0.0;
+    double missesAfter = 0.0;
+    size_t triangles = 0;
+};
 
+// everything loading a model produces before it needs the GL context. Filled by Model::importModel, which only
+// touches this struct and so can run on a worker thread.
+struct ModelImport {
+    // input
+    string path;
+    string directory;
+    bool nativeObj = false;
+    bool optimize = false;
+    bool lods = false;
+    bool decodeTextures = false;   // decode all textures during the import (asynchronous loads)
+
+    // output
+    bool succeeded = false;
+    const char *kind = "";         // for reporting: where the meshes came from
+    bool hashed = false;
+    uint64_t sourceHash = 0;
+    MeshCache cache;               // warm loads, the meshes are uploaded straight from its mapping
+    vector<MeshData> meshes;       // cold loads, already optimized
+    vector<TextureRef> textures;   // every texture path the meshes use once, with the type of its first use
+    vector<TextureImage> images;   // decoded texels, parallel to textures. Entries with an empty path weren't decoded.
+    bool hasBounds = false;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    ModelOptimizeStats optimizeStats;
+
+    unsigned int processingFlags() const
+    {
+        return (optimize ? MODEL_PROCESS_OPTIMIZE : 0) | (nativeObj ? MODEL_PROCESS_NATIVE_OBJ : 0) |
+               (lods ? MODEL_PROCESS_LODS : 0);
+    }
 
+    size_t meshCount() const
+    {
+        return meshes.empty() ? cache.Meshes().size() : meshes.size();
+    }
+};
 
 class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// every texture this model holds a reference to in the global TextureCache, one entry per unique path.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    bool parallelTextureDecode;
+    bool retainGeometry;
+    VertexFormat vertexFormat;
+    bool optimizeMeshes;
+    bool generateLods;
+    bool nativeObjLoader;
+    // largest simplification error, in pixels, a LOD may show on screen
+    float lodPixelError = 1.0f;
+    // triangles submitted by the last Draw call
+    size_t trianglesDrawn = 0;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false)
+        : gammaCorrection(gamma), parallelTextureDecode(false), retainGeometry(false), vertexFormat(VertexFormat::Full),
+          optimizeMeshes(false), generateLods(false), nativeObjLoader(false)
     {
         loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
+    Model(string const &path, const ModelLoadOptions &options)
+        : gammaCorrection(options.gammaCorrection), parallelTextureDecode(options.parallelTextureDecode),
+          retainGeometry(options.retainGeometry),
+          vertexFormat(options.compactVertices ? VertexFormat::Compact : VertexFormat::Full),
+          optimizeMeshes(options.optimizeMeshes), generateLods(options.generateLods), nativeObjLoader(options.nativeObjLoader)
+    {
+        if (options.asyncLoad)
+            loadModelAsync(path);
+        else
+            loadModel(path);
+    }
+
+    // draws the model, and thus all its meshes. Draws nothing while the model is still loading.
     void Draw(Shader &shader)
     {
+        if (!IsReady())
+            return;
+        trianglesDrawn = 0;
         for(unsigned int i = 0; i < meshes.size(); i++)
+        {
             meshes[i].Draw(shader);
+            trianglesDrawn += meshes[i].lods[0].indexCount / 3;
+        }
+    }
+
+    // draws every mesh at the coarsest LOD whose error projects to at most lodPixelError pixels on a screen
+    // screenHeight pixels high, seen through camera (its Zoom is the vertical field of view) and placed with modelMatrix.
+    // Textures are streamed in only down to the mip levels that distance needs.
+    void Draw(Shader &shader, const Camera &camera, const glm::mat4 &modelMatrix, float screenHeight)
+    {
+        if (!IsReady())
+            return;
+        // pixels covered by one world unit at distance 1, and the largest scale of the model matrix
+        float pixelsAtUnitDistance = screenHeight / (2.0f * tanf(glm::radians(camera.Zoom) * 0.5f));
+        float scale = max(glm::length(glm::vec3(modelMatrix[0])),
+                          max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+
+        trianglesDrawn = 0;
+        for (Mesh &mesh : meshes)
+        {
+            // distance to the nearest point of the bounding sphere, so the error is never underestimated
+            glm::vec3 center = glm::vec3(modelMatrix * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+            float radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f * scale;
+            float distance = max(glm::length(center - camera.Position) - radius, 1e-4f);
+            float pixelsPerUnit = pixelsAtUnitDistance * scale / distance;
+            unsigned int lod = mesh.SelectLod(pixelsPerUnit, lodPixelError);
+            mesh.Draw(shader, lod, pixelsPerUnit);
+            trianglesDrawn += mesh.lods[lod].indexCount / 3;
+        }
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
+        textureNamePrefix = prefix;
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.SetGlslIdentifierPrefix(prefix);
+        }
+    }
+
+    // gives back the references this model holds in the global TextureCache. The textures stay resident until
+    // TextureCache::EvictUnused is called, the model must not be drawn afterwards.
+    void ReleaseTextures()
+    {
+        for (const Texture &texture : textures_loaded)
+            if (texture.id)
+                TextureCache::Instance().Release(texture.id);
+        textures_loaded.clear();
+        textureIndex.clear();
+    }
+
+    // whether all meshes and textures are loaded. Always true for models loaded synchronously.
+    bool IsReady() const
+    {
+        return !pending;
+    }
+
+    // continues an asynchronous load, call once per frame on the render thread. Creates textures and meshes until
+    // budgetMs milliseconds are used up, but always at least one, so a load finishes at any frame rate.
+    // Returns IsReady().
+    bool Update(double budgetMs = 2.0)
+    {
+        if (!pending)
+            return true;
+        if (async && !async->imported)
+            return false;
+        if (async && async->worker.joinable())
+            async->worker.join();
+        return finishLoad(budgetMs);
+    }
+
+    ModelLoadProgress Progress() const
+    {
+        if (!pending)
+            return ModelLoadProgress{"ready", 1, 1};
+        if (async && !async->imported)
+        {
+            size_t toDecode = async->texturesToDecode;
+            if (toDecode == 0)
+                return ModelLoadProgress{"importing", 0, 0};
+            return ModelLoadProgress{"decoding textures", async->texturesDecoded, toDecode};
         }
+        return ModelLoadProgress{"uploading", nextTexture + meshes.size(), pending->textures.size() + pending->meshCount()};
+    }
+
+    // draws the bounding box of a model that is still loading as lines, with a shader taking positions at location 0
+    // (e.g. lightcube.vs). Draws nothing before the import has determined the bounds or once the model is ready.
+    void DrawPlaceholder(Shader &shader)
+    {
+        if (!pending || (async && !async->imported) || !pending->hasBounds)
+            return;
+        if (placeholderVAO == 0)
+            setupPlaceholder(pending->boundsMin, pending->boundsMax);
+        shader.use();
+        GLState::Instance().BindVertexArray(placeholderVAO);
+        glDrawElements(GL_LINES, 24, GL_UNSIGNED_SHORT, 0);
     }
 private:
+    unordered_map<string, size_t> textureIndex; // path as referenced by the materials -> index in textures_loaded
+    string textureNamePrefix;
+    ModelOptimizeStats optimizeStats;
+
+    // state of a load whose GL side isn't finished yet
+    struct AsyncLoad {
+        thread worker;
+        atomic<bool> imported{false};
+        atomic<size_t> texturesToDecode{0};
+        atomic<size_t> texturesDecoded{0};
+
+        ~AsyncLoad()
+        {
+            if (worker.joinable())
+                worker.join();
+        }
+    };
+    unique_ptr<ModelImport> pending;   // the worker of an async load only touches this and async
+    unique_ptr<AsyncLoad> async;
+    size_t nextTexture = 0;
+    chrono::steady_clock::time_point loadStart;
+    unsigned int placeholderVAO = 0, placeholderVBO = 0, placeholderEBO = 0;
+
+    static bool isObjFile(string const &path)
+    {
+        if (path.size() < 4)
+            return false;
+        string extension = path.substr(path.size() - 4);
+        for (char &c : extension)
+            c = (char)tolower((unsigned char)c);
+        return extension == ".obj";
+    }
+
+    // hash of the model file for the mesh cache key. An OBJ's materials, and with them the texture references stored
+    // in the cache, come from its mtllib files and their sidecars, so their hashes are folded in (a missing one counts
+    // as 0).
+    static bool hashSource(string const &path, uint64_t &hash)
+    {
+        if (!MeshCache::HashFile(path, hash))
+            return false;
+        if (!isObjFile(path))
+            return true;
+        const uint64_t prime = 0x100000001b3ULL;
+        for (const string &library : ObjLoader::MaterialLibraries(path))
+        {
+            uint64_t libraryHash = 0, sidecarHash = 0;
+            MeshCache::HashFile(library, libraryHash);
+            MeshCache::HashFile(MaterialLibrary::SidecarPath(library), sidecarHash);
+            hash = (hash ^ libraryHash) * prime;
+            hash = (hash ^ sidecarHash) * prime;
+        }
+        return true;
+    }
+
+    void beginLoad(string const &path)
+    {
+        loadStart = chrono::steady_clock::now();
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        pending.reset(new ModelImport());
+        pending->path = path;
+        pending->directory = directory;
+        pending->nativeObj = nativeObjLoader && isObjFile(path);
+        pending->optimize = optimizeMeshes;
+        pending->lods = generateLods;
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // The processed meshes are kept in a binary cache next to the model, assimp only runs when that cache is stale.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        beginLoad(path);
+        importModel(*pending);
+        if (parallelTextureDecode)
+            decodeMissingTextures();
+        finishLoad(numeric_limits<double>::infinity());
+    }
+
+    // starts the import on a worker thread, Update does the rest
+    void loadModelAsync(string const &path)
+    {
+        beginLoad(path);
+        pending->decodeTextures = true;
+        async.reset(new AsyncLoad());
+        ModelImport *import = pending.get();
+        AsyncLoad *state = async.get();
+        state->worker = thread([import, state]() {
+            importModel(*import, &state->texturesToDecode, &state->texturesDecoded);
+            state->imported = true;
+        });
+    }
+
+    // the CPU side of loading: reads the meshes from the mesh cache, or imports and optimizes them and writes the
+    // cache, and collects (and optionally decodes) the textures they use
+    static void importModel(ModelImport &import, atomic<size_t> *texturesToDecode = nullptr,
+                            atomic<size_t> *texturesDecoded = nullptr)
+    {
+        // try the mesh cache first
+        import.hashed = hashSource(import.path, import.sourceHash);
+        string cachePath = MeshCache::CachePath(import.path);
+        // the cache is keyed on the requested processing, also when the native loader fails and assimp's meshes end
+        // up in it, so the next load with the same options finds them
+        unsigned int processingFlags = import.processingFlags();
+        if (import.hashed && import.cache.Open(cachePath, import.sourceHash, MODEL_IMPORT_FLAGS, processingFlags))
+        {
+            import.kind = "warm, mesh cache";
+            for (const CachedMesh &mesh : import.cache.Meshes())
+            {
+                addTextures(import, PackedTextureRefs(import.directory, mesh.textures));
+                addBounds(import, mesh.vertices, mesh.vertexCount);
+            }
+        }
+        else
+        {
+            import.kind = "cold, native obj";
+            if (!import.nativeObj || !ObjLoader::Load(import.path, import.meshes))
+            {
+                import.kind = "cold, assimp";
+                import.meshes.clear();
+
+                // read file via ASSIMP
+                Assimp::Importer importer;
+                const aiScene* scene = importer.ReadFile(import.path, MODEL_IMPORT_FLAGS);
+                // check for errors
+                if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+                {
+                    cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                    return;
+                }
+
+                // assimp doesn't load occlusion maps, they come from the material libraries like for ObjLoader
+                map<string, MaterialMaps> libraryMaps;
+                if (isObjFile(import.path))
+                    for (const string &library : ObjLoader::MaterialLibraries(import.path))
+                        MaterialLibrary::Read(library, libraryMaps);
+
+                // process ASSIMP's root node recursively
+                import.meshes.reserve(scene->mNumMeshes);
+                processNode(scene->mRootNode, scene, libraryMaps, import.meshes);
+            }
+
+            for (MeshData &mesh : import.meshes)
+            {
+                if (import.optimize)
+                    optimizeMesh(mesh.vertices, mesh.indices, import.optimizeStats);
+                if (import.lods)
+                    MeshSimplifier::BuildLods(mesh.vertices, mesh.indices, mesh.lods);
+                addTextures(import, PackedTextureRefs(import.directory, mesh.textures));
+                addBounds(import, mesh.vertices.data(), mesh.vertices.size());
+            }
+            if (import.hashed && !MeshCache::Write(cachePath, import.sourceHash, MODEL_IMPORT_FLAGS, processingFlags, import.meshes))
+                cout << "WARNING::MESH_CACHE:: failed to write " << cachePath << endl;
+        }
+
+        if (import.decodeTextures)
+        {
+            // the global TextureCache can't be asked from this thread, so textures other models already loaded are
+            // decoded as well and dropped again in uploadTexture. Baked textures need no decoding.
+            vector<size_t> toDecode;
+            vector<string> paths;
+            vector<bool> srgb;
+            for (size_t i = 0; i < import.textures.size(); i++)
+            {
+                string path = import.directory + '/' + import.textures[i].path;
+                if (HasBakedTexture(path))
+                    continue;
+                toDecode.push_back(i);
+                paths.push_back(path);
+                srgb.push_back(IsColorTexture(import.textures[i].type));
+            }
+            if (texturesToDecode)
+                *texturesToDecode = paths.size();
+            vector<TextureImage> images = DecodeTextureImagesParallel(paths, 0, texturesDecoded, srgb);
+            import.images.resize(import.textures.size());
+            for (size_t i = 0; i < toDecode.size(); i++)
+                import.images[toDecode[i]] = images[i];
+        }
+        import.succeeded = true;
+    }
+
+    static void addTextures(ModelImport &import, const vector<TextureRef> &textures)
+    {
+        for (const TextureRef &texture : textures)
+        {
+            bool known = false;
+            for (const TextureRef &other : import.textures)
+                known = known || other.path == texture.path;
+            if (!known)
+                import.textures.push_back(texture);
+        }
+    }
+
+    static void addBounds(ModelImport &import, const Vertex *vertices, size_t vertexCount)
+    {
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            if (!import.hasBounds)
+                import.boundsMin = import.boundsMax = vertices[i].Position;
+            import.hasBounds = true;
+            import.boundsMin = glm::min(import.boundsMin, vertices[i].Position);
+            import.boundsMax = glm::max(import.boundsMax, vertices[i].Position);
+        }
+    }
+
+    // decodes the textures of the pending import that are neither resident yet nor baked on worker threads
+    void decodeMissingTextures()
+    {
+        vector<size_t> missing;
+        vector<string> paths;
+        vector<bool> srgb;
+        for (size_t i = 0; i < pending->textures.size(); i++)
+        {
+            string filename = directory + '/' + pending->textures[i].path;
+            if (TextureCache::Instance().Contains(filename) || HasBakedTexture(filename))
+                continue;
+            missing.push_back(i);
+            paths.push_back(filename);
+            srgb.push_back(IsColorTexture(pending->textures[i].type));
+        }
+        vector<TextureImage> images = DecodeTextureImagesParallel(paths, 0, nullptr, srgb);
+        pending->images.resize(pending->textures.size());
+        for (size_t i = 0; i < missing.size(); i++)
+            pending->images[missing[i]] = images[i];
+    }
+
+    // the GL side of loading: uploads the textures, then the meshes of the pending import, one at a time until
+    // budgetMs is used up. Returns true once the model is complete.
+    bool finishLoad(double budgetMs)
+    {
+        ModelImport &import = *pending;
+        auto start = chrono::steady_clock::now();
+        size_t meshCount = import.succeeded ? import.meshCount() : 0;
+        meshes.reserve(meshCount);
+        do
+        {
+            if (nextTexture < import.textures.size())
+                uploadTexture(nextTexture++);
+            else if (meshes.size() < meshCount)
+                createMesh(meshes.size());
+            else
+                break;
+        } while (chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() < budgetMs);
+        if (nextTexture < import.textures.size() || meshes.size() < meshCount)
+            return false;
+
+        if (import.succeeded)
+        {
+            optimizeStats = import.optimizeStats;
+            reportLoadTime(import.path, import.kind, loadStart);
+            if (optimizeMeshes && !import.meshes.empty())
+                reportOptimization(import.path);
+            if (generateLods)
+                reportLods(import.path);
+        }
+        if (placeholderVAO)
+        {
+            GLState::Instance().DeleteVertexArrays(1, &placeholderVAO);
+            glDeleteBuffers(1, &placeholderVBO);
+            glDeleteBuffers(1, &placeholderEBO);
+            placeholderVAO = 0;
+        }
+        async.reset();
+        pending.reset();
+        return true;
+    }
+
+    // takes the texture from the global cache, uploads its decoded texels or loads it there and then. The textures
+    // are streamed, Mesh::Draw touches them with the mip level every draw needs.
+    void uploadTexture(size_t i)
+    {
+        const TextureRef &ref = pending->textures[i];
+        string filename = directory + '/' + ref.path;
+        TextureImage *image = i < pending->images.size() && !pending->images[i].path.empty() ? &pending->images[i] : nullptr;
+
+        Texture texture;
+        texture.type = ref.type;
+        texture.path = ref.path;
+        if (image && !TextureCache::Instance().TryAcquire(filename, texture.id, true))
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            if (!image->Decoded())
+                std::cout << "Texture failed to load at path: " << ref.path << std::endl;
+            texture.id = TextureCache::Instance().Insert(filename, *image, IsColorTexture(ref.type), true);
+        }
+        else if (!image)
+            texture.id = TextureCache::Instance().Acquire(filename, IsColorTexture(ref.type), true);
+        if (image)
+            FreeTextureImage(*image);
+
+        textureIndex[ref.path] = textures_loaded.size();
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+    }
+
+    // uploads mesh i of the pending import, its textures are resident by now
+    void createMesh(size_t i)
+    {
+        ModelImport &import = *pending;
+        const vector<TextureRef> &materialRefs = import.meshes.empty() ? import.cache.Meshes()[i].textures : import.meshes[i].textures;
+        vector<TextureRef> refs = PackedTextureRefs(import.directory, materialRefs);
+        vector<Texture> textures;
+        textures.reserve(refs.size());
+        for (const TextureRef &ref : refs)
+            textures.push_back(textures_loaded[textureIndex[ref.path]]);
+
+        if (import.meshes.empty())
+        {
+            // straight from the mapped cache file
+            const CachedMesh &cached = import.cache.Meshes()[i];
+            if (retainGeometry)
+                meshes.push_back(Mesh(vector<Vertex>(cached.vertices, cached.vertices + cached.vertexCount),
+                                      vector<unsigned int>(cached.indices, cached.indices + cached.indexCount),
+                                      std::move(textures), vertexFormat, vector<MeshLod>(cached.lods)));
+            else
+                meshes.push_back(Mesh(cached.vertices, cached.vertexCount, cached.indices, cached.indexCount, std::move(textures),
+                                      vertexFormat, vector<MeshLod>(cached.lods)));
+        }
+        else
+        {
+            MeshData &data = import.meshes[i];
+            meshes.push_back(Mesh(std::move(data.vertices), std::move(data.indices), std::move(textures), vertexFormat,
+                                  std::move(data.lods)));
+            // the mesh cache was the last user of the CPU side geometry
+            if (!retainGeometry)
+                meshes.back().ReleaseGeometry();
+        }
+        meshes.back().SetGlslIdentifierPrefix(textureNamePrefix);
+    }
+
+    void setupPlaceholder(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        glm::vec3 corners[8];
+        for (int i = 0; i < 8; i++)
+            corners[i] = glm::vec3(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y,
+                                   i & 4 ? boundsMax.z : boundsMin.z);
+        static const unsigned short edges[24] = {0, 1, 2, 3, 4, 5, 6, 7, 0, 2, 1, 3, 4, 6, 5, 7, 0, 4, 1, 5, 2, 6, 3, 7};
+
+        glGenVertexArrays(1, &placeholderVAO);
+        glGenBuffers(1, &placeholderVBO);
+        glGenBuffers(1, &placeholderEBO);
+        GLState::Instance().BindVertexArray(placeholderVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, placeholderVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, placeholderEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(edges), edges, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        GLState::Instance().BindVertexArray(0);
+    }
+
+    void reportLoadTime(string const &path, const char *kind, chrono::steady_clock::time_point start)
+    {
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "MODEL::LOAD " << path << " (" << kind << "): " << ms << " ms" << endl;
+
+        size_t vertexCount = 0;
+        for (const Mesh &mesh : meshes)
+            vertexCount += mesh.vertexCount;
+        size_t vertexSize = vertexFormat == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+        cout << "MODEL::VERTEX_BUFFERS " << path << ": " << vertexCount << " vertices, " << vertexSize << " bytes/vertex, "
+             << vertexCount * vertexSize / 1024 << " KB (full format: " << vertexCount * sizeof(Vertex) / 1024 << " KB)" << endl;
+    }
+
+    void reportOptimization(string const &path)
+    {
+        if (optimizeStats.triangles == 0)
             return;
+        size_t indexCount = 0, indexBytes = 0;
+        for (const Mesh &mesh : meshes)
+        {
+            indexCount += mesh.indexCount;
+            indexBytes += mesh.IndexBufferBytes();
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        cout << "MODEL::OPTIMIZE " << path << ": ACMR " << optimizeStats.missesBefore / optimizeStats.triangles
+             << " -> " << optimizeStats.missesAfter / optimizeStats.triangles << ", index buffers "
+             << indexCount * sizeof(unsigned int) / 1024 << " KB -> " << indexBytes / 1024 << " KB" << endl;
+    }
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+    void reportLods(string const &path)
+    {
+        size_t levels = 0;
+        for (const Mesh &mesh : meshes)
+            levels = max(levels, mesh.lods.size());
+        // meshes with fewer levels count with their coarsest one
+        vector<size_t> triangles(levels, 0);
+        for (const Mesh &mesh : meshes)
+            for (size_t lod = 0; lod < levels; lod++)
+                triangles[lod] += mesh.lods[min(lod, mesh.lods.size() - 1)].indexCount / 3;
+        cout << "MODEL::LODS " << path << ": triangles per level";
+        for (size_t count : triangles)
+            cout << " " << count;
+        cout << endl;
+    }
+
+    // import time reordering of a mesh for the post transform vertex cache, overdraw and vertex fetch
+    static void optimizeMesh(vector<Vertex> &vertices, vector<unsigned int> &indices, ModelOptimizeStats &stats)
+    {
+        size_t triangles = indices.size() / 3;
+        stats.triangles += triangles;
+        stats.missesBefore += ComputeACMR(indices, vertices.size()) * triangles;
+
+        OptimizeVertexCache(indices, vertices.size());
+        OptimizeOverdraw(indices, vertices);
+        OptimizeVertexFetch(vertices, indices);
+
+        stats.missesAfter += ComputeACMR(indices, vertices.size()) * triangles;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, const map<string, MaterialMaps> &libraryMaps,
+                            vector<MeshData> &result)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -81,22 +681,24 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            result.push_back(processMesh(mesh, scene, libraryMaps));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, libraryMaps, result);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene, const map<string, MaterialMaps> &libraryMaps)
     {
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
-        vector<Texture> textures;
+        vector<TextureRef> textures;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3); // faces are triangles after aiProcess_Triangulate
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -164,95 +766,64 @@ private:
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        vector<TextureRef> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+        vector<TextureRef> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+        std::vector<TextureRef> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
         textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+        std::vector<TextureRef> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // 5. occlusion maps, only used packed (see PackedTextureRefs)
+        aiString materialName;
+        material->Get(AI_MATKEY_NAME, materialName);
+        map<string, MaterialMaps>::const_iterator maps = libraryMaps.find(materialName.C_Str());
+        if (maps != libraryMaps.end())
+            for (const string &path : maps->second.maps[MATERIAL_MAP_OCCLUSION])
+                textures.push_back(TextureRef{"texture_occlusion", path});
+
+        // return the extracted mesh data
+        MeshData data;
+        data.vertices = std::move(vertices);
+        data.indices = std::move(indices);
+        data.textures = std::move(textures);
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // collects the paths of all material textures of a given type, they are loaded when the mesh is created.
+    static vector<TextureRef> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
-        vector<Texture> textures;
+        vector<TextureRef> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            TextureRef texture;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
         return textures;
     }
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+inline unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
+    unsigned int baked = LoadBakedTexture(filename);
+    if (baked)
+        return baked;
+    TextureImage image;
+    if (!DecodeTextureImage(filename, image, gamma))
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+    unsigned int textureID = UploadTextureImage(image);
+    FreeTextureImage(image);
 
     return textureID;
 }
@@ -0,0 +1,87 @@
+#ifndef NORMAL_MATRIX_H
+#define NORMAL_MATRIX_H
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define NORMAL_MATRIX_SSE 1
+#endif
+
+// The normal matrix transforms normals the way the model matrix transforms positions: the inverse transpose of its
+// upper 3x3 part. Shaders get it as the normalMatrix uniform instead of evaluating mat3(transpose(inverse(model))) on
+// every vertex.
+//
+// The inverse transpose of a 3x3 matrix with columns a, b, c has the columns b x c, c x a and a x b divided by its
+// determinant a . (b x c), three cross products and a dot product, done with SSE on the columns of the model matrix
+// as they are in memory.
+
+inline glm::mat3 NormalMatrix(const glm::mat4 &model)
+{
+#ifdef NORMAL_MATRIX_SSE
+    // the w components are carried along, they cancel out in the cross products
+    __m128 a = _mm_loadu_ps(&model[0][0]);
+    __m128 b = _mm_loadu_ps(&model[1][0]);
+    __m128 c = _mm_loadu_ps(&model[2][0]);
+    auto cross = [](__m128 u, __m128 v) {
+        __m128 uYZX = _mm_shuffle_ps(u, u, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 vYZX = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 crossZXY = _mm_sub_ps(_mm_mul_ps(u, vYZX), _mm_mul_ps(uYZX, v));
+        return _mm_shuffle_ps(crossZXY, crossZXY, _MM_SHUFFLE(3, 0, 2, 1));
+    };
+    __m128 bc = cross(b, c);
+    __m128 ca = cross(c, a);
+    __m128 ab = cross(a, b);
+    // determinant, summed over x, y and z (w of the cross product is 0)
+    __m128 products = _mm_mul_ps(a, bc);
+    __m128 sum = _mm_add_ps(products, _mm_movehl_ps(products, products));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+    float determinant = _mm_cvtss_f32(sum);
+    // a singular matrix (scaled by 0 along some axis) gets the cofactors undivided
+    __m128 scale = _mm_set1_ps(determinant != 0.0f ? 1.0f / determinant : 1.0f);
+    float columns[3][4];
+    _mm_storeu_ps(columns[0], _mm_mul_ps(bc, scale));
+    _mm_storeu_ps(columns[1], _mm_mul_ps(ca, scale));
+    _mm_storeu_ps(columns[2], _mm_mul_ps(ab, scale));
+    return glm::mat3(glm::vec3(columns[0][0], columns[0][1], columns[0][2]),
+                     glm::vec3(columns[1][0], columns[1][1], columns[1][2]),
+                     glm::vec3(columns[2][0], columns[2][1], columns[2][2]));
+#else
+    glm::vec3 a(model[0]), b(model[1]), c(model[2]);
+    glm::vec3 bc = glm::cross(b, c);
+    float determinant = glm::dot(a, bc);
+    float scale = determinant != 0.0f ? 1.0f / determinant : 1.0f;
+    return glm::mat3(bc * scale, glm::cross(c, a) * scale, glm::cross(a, b) * scale);
+#endif
+}
+
+// a model matrix with its normal matrix, which is only recomputed when the model matrix changes
+class ModelTransform
+{
+public:
+    void Set(const glm::mat4 &matrix)
+    {
+        if (valid && matrix == model)
+            return;
+        model = matrix;
+        normal = NormalMatrix(matrix);
+        valid = true;
+    }
+
+    const glm::mat4 &Model() const
+    {
+        return model;
+    }
+
+    const glm::mat3 &Normal() const
+    {
+        return normal;
+    }
+
+private:
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::mat3 normal = glm::mat3(1.0f);
+    bool valid = false;
+};
+
+#endif
@@ -0,0 +1,630 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/material_library.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/text_scan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Dedicated Wavefront OBJ/MTL importer, used by Model instead of assimp for .obj files.
+//
+// The file is mmap'd and cut into line aligned chunks that are parsed on worker threads in two passes: the first one
+// only counts the v/vt/vn lines of every chunk, which gives each chunk the global index of its first position, uv and
+// normal, so the second pass can resolve relative (negative) face indices on its own and write its attributes
+// straight into the shared arrays. The faces are then grouped by material and every distinct v/vt/vn tuple becomes one
+// vertex, deduplicated with a flat open addressing hash map.
+//
+// The result matches what Model::processMesh builds from assimp with MODEL_IMPORT_FLAGS: faces are triangulated as
+// fans, missing normals are generated smooth over all vertices at the same position, tangents and bitangents are
+// computed from the uvs and uvs are flipped vertically. Texture types follow assimp's OBJ mapping (map_Kd diffuse,
+// map_Ks specular, map_Bump/bump height -> texture_normal, map_Ka ambient -> texture_height), map_ao from the library
+// or its sidecar (see material_library.h) becomes texture_occlusion.
+class ObjLoader
+{
+public:
+    // loads the OBJ at path (and its mtllib files) into one MeshData per material. Returns false if the file can't be
+    // read or is malformed (e.g. indices out of range), in which case the caller should fall back to assimp.
+    static bool Load(const string &path, vector<MeshData> &result, unsigned int maxThreads = 0)
+    {
+        MappedFile file;
+        if (!file.open(path))
+            return false;
+        const char *data = (const char *)file.data();
+        size_t size = file.size();
+
+        // split into chunks of at least 1 MB that start at the beginning of a line
+        unsigned int threadCount = maxThreads ? maxThreads : thread::hardware_concurrency();
+        threadCount = max(1u, min(threadCount, (unsigned int)(size / (1 << 20) + 1)));
+        vector<Chunk> chunks(threadCount);
+        size_t chunkStart = 0;
+        for (unsigned int i = 0; i < threadCount; i++)
+        {
+            size_t end = (i + 1 == threadCount) ? size : max(chunkStart, size * (i + 1) / threadCount);
+            while (end < size && data[end - 1] != '\n')
+                end++;
+            chunks[i].begin = data + chunkStart;
+            chunks[i].end = data + end;
+            chunkStart = end;
+        }
+
+        // pass 1: attribute counts, their prefix sums are the chunk bases
+        runParallel(chunks, [](Chunk &chunk) { countAttributes(chunk); });
+        size_t positionCount = 0, uvCount = 0, normalCount = 0;
+        for (Chunk &chunk : chunks)
+        {
+            chunk.positionBase = positionCount;
+            chunk.uvBase = uvCount;
+            chunk.normalBase = normalCount;
+            positionCount += chunk.positionCount;
+            uvCount += chunk.uvCount;
+            normalCount += chunk.normalCount;
+        }
+
+        // pass 2: attributes go straight into the shared arrays, faces into per chunk corner lists
+        Attributes attributes;
+        attributes.positions.resize(positionCount);
+        attributes.uvs.resize(uvCount);
+        attributes.normals.resize(normalCount);
+        runParallel(chunks, [&attributes](Chunk &chunk) { parseChunk(chunk, attributes); });
+
+        for (const Chunk &chunk : chunks)
+        {
+            if (!chunk.error.empty())
+            {
+                cout << "ERROR::OBJ_LOADER:: " << path << ": " << chunk.error << endl;
+                return false;
+            }
+        }
+
+        string directory = path.substr(0, path.find_last_of('/'));
+        map<string, vector<TextureRef>> materials;
+        for (const Chunk &chunk : chunks)
+            for (const string &library : chunk.materialLibraries)
+                loadMaterialLibrary(directory + '/' + library, materials);
+
+        buildMeshes(chunks, attributes, materials, result);
+        return true;
+    }
+
+    // paths of the material libraries the OBJ at path names in its mtllib statements, in order
+    static vector<string> MaterialLibraries(const string &path)
+    {
+        vector<string> libraries;
+        MappedFile file;
+        if (!file.open(path))
+            return libraries;
+        string directory = path.substr(0, path.find_last_of('/'));
+        const char *data = (const char *)file.data();
+        const char *dataEnd = data + file.size();
+        for (const char *p = data; p < dataEnd;)
+        {
+            const char *end = lineEnd(p, dataEnd);
+            const char *lineStart = SkipBlanks(p, end);
+            p = end + 1;
+            if (IsKeyword(lineStart, end, "mtllib", 6))
+                libraries.push_back(directory + '/' + TrimBlanks(lineStart + 6, end));
+        }
+        return libraries;
+    }
+
+private:
+    // a face corner, indices into the global position/uv/normal arrays, -1 if absent
+    struct Corner {
+        int32_t position;
+        int32_t uv;
+        int32_t normal;
+    };
+
+    struct MaterialSwitch {
+        size_t firstTriangle; // index into the chunk's triangles
+        string material;
+    };
+
+    struct Chunk {
+        const char *begin = nullptr;
+        const char *end = nullptr;
+        size_t positionCount = 0, uvCount = 0, normalCount = 0;
+        size_t positionBase = 0, uvBase = 0, normalBase = 0;
+        vector<Corner> corners; // 3 per triangle
+        vector<MaterialSwitch> materialSwitches;
+        vector<string> materialLibraries;
+        string error;
+    };
+
+    struct Attributes {
+        vector<glm::vec3> positions;
+        vector<glm::vec2> uvs;
+        vector<glm::vec3> normals;
+    };
+
+    template <typename Function>
+    static void runParallel(vector<Chunk> &chunks, Function function)
+    {
+        vector<thread> workers;
+        for (size_t i = 1; i < chunks.size(); i++)
+            workers.emplace_back([&chunks, &function, i]() { function(chunks[i]); });
+        function(chunks[0]);
+        for (thread &worker : workers)
+            worker.join();
+    }
+
+    static const char *lineEnd(const char *p, const char *end)
+    {
+        const char *newline = (const char *)memchr(p, '\n', end - p);
+        return newline ? newline : end;
+    }
+
+    // locale independent float parser for the plain decimal/exponent notation OBJ files use
+    static const char *parseFloat(const char *p, const char *end, float &value)
+    {
+        static const double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                            1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        p = SkipBlanks(p, end);
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+
+        const char *digitsStart = p;
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa)
+                    digits++;
+            }
+            else
+                exponent++;
+        }
+        if (p < end && *p == '.')
+        {
+            for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+            {
+                if (digits < 19)
+                {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    if (mantissa)
+                        digits++;
+                    exponent--;
+                }
+            }
+        }
+        if (p == digitsStart)
+            return nullptr;
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char *q = p + 1;
+            bool negativeExponent = false;
+            if (q < end && (*q == '-' || *q == '+'))
+                negativeExponent = *q++ == '-';
+            if (q < end && *q >= '0' && *q <= '9')
+            {
+                int e = 0;
+                for (; q < end && *q >= '0' && *q <= '9'; q++)
+                    e = min(e * 10 + (*q - '0'), 10000);
+                exponent += negativeExponent ? -e : e;
+                p = q;
+            }
+        }
+
+        double result = (double)mantissa;
+        while (exponent > 22)
+        {
+            result *= 1e22;
+            exponent -= 22;
+        }
+        while (exponent < -22)
+        {
+            result /= 1e22;
+            exponent += 22;
+        }
+        result = exponent >= 0 ? result * powersOf10[exponent] : result / powersOf10[-exponent];
+        value = (float)(negative ? -result : result);
+        return p;
+    }
+
+    static const char *parseInt(const char *p, const char *end, long &value)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        if (p >= end || *p < '0' || *p > '9')
+            return nullptr;
+        long result = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+            result = result * 10 + (*p - '0');
+        value = negative ? -result : result;
+        return p;
+    }
+
+    static void countAttributes(Chunk &chunk)
+    {
+        for (const char *p = chunk.begin; p < chunk.end;)
+        {
+            const char *end = lineEnd(p, chunk.end);
+            const char *q = SkipBlanks(p, end);
+            if (end - q > 2 && q[0] == 'v')
+            {
+                if (IsBlank(q[1]))
+                    chunk.positionCount++;
+                else if (q[1] == 't' && IsBlank(q[2]))
+                    chunk.uvCount++;
+                else if (q[1] == 'n' && IsBlank(q[2]))
+                    chunk.normalCount++;
+            }
+            p = end + 1;
+        }
+    }
+
+    // resolves an OBJ index (1 based, or negative relative to the attributes read so far) to a 0 based global one
+    static bool resolveIndex(long index, size_t readSoFar, size_t total, int32_t &resolved)
+    {
+        long result = index > 0 ? index - 1 : (long)readSoFar + index;
+        if (index == 0 || result < 0 || (size_t)result >= total)
+            return false;
+        resolved = (int32_t)result;
+        return true;
+    }
+
+    static void parseChunk(Chunk &chunk, Attributes &attributes)
+    {
+        size_t positions = chunk.positionBase, uvs = chunk.uvBase, normals = chunk.normalBase;
+        vector<Corner> face;
+        for (const char *p = chunk.begin; p < chunk.end && chunk.error.empty();)
+        {
+            const char *end = lineEnd(p, chunk.end);
+            const char *lineStart = SkipBlanks(p, end);
+            p = end + 1;
+            // drop a trailing carriage return of CRLF files
+            if (end > lineStart && end[-1] == '\r')
+                end--;
+            if (lineStart == end || *lineStart == '#')
+                continue;
+
+            if (IsKeyword(lineStart, end, "v", 1))
+            {
+                glm::vec3 &position = attributes.positions[positions++];
+                const char *q = lineStart + 1;
+                for (int i = 0; i < 3 && q; i++)
+                    q = parseFloat(q, end, position[i]);
+                if (!q)
+                    chunk.error = "malformed vertex position";
+            }
+            else if (IsKeyword(lineStart, end, "vt", 2))
+            {
+                glm::vec2 &uv = attributes.uvs[uvs++];
+                uv = glm::vec2(0.0f, 0.0f);
+                const char *q = parseFloat(lineStart + 2, end, uv.x);
+                // the v coordinate is optional
+                if (q && SkipBlanks(q, end) < end)
+                    q = parseFloat(q, end, uv.y);
+                if (!q)
+                    chunk.error = "malformed texture coordinate";
+            }
+            else if (IsKeyword(lineStart, end, "vn", 2))
+            {
+                glm::vec3 &normal = attributes.normals[normals++];
+                const char *q = lineStart + 2;
+                for (int i = 0; i < 3 && q; i++)
+                    q = parseFloat(q, end, normal[i]);
+                if (!q)
+                    chunk.error = "malformed vertex normal";
+            }
+            else if (IsKeyword(lineStart, end, "f", 1))
+            {
+                face.clear();
+                const char *q = SkipBlanks(lineStart + 1, end);
+                while (q < end)
+                {
+                    Corner corner = {-1, -1, -1};
+                    long index;
+                    q = parseInt(q, end, index);
+                    if (!q || !resolveIndex(index, positions, attributes.positions.size(), corner.position))
+                        break;
+                    if (q < end && *q == '/')
+                    {
+                        q++;
+                        if (q < end && *q != '/')
+                        {
+                            q = parseInt(q, end, index);
+                            if (!q || !resolveIndex(index, uvs, attributes.uvs.size(), corner.uv))
+                                break;
+                        }
+                        if (q < end && *q == '/')
+                        {
+                            q = parseInt(q + 1, end, index);
+                            if (!q || !resolveIndex(index, normals, attributes.normals.size(), corner.normal))
+                                break;
+                        }
+                    }
+                    face.push_back(corner);
+                    q = SkipBlanks(q, end);
+                }
+                if (q != end || face.size() < 3)
+                {
+                    chunk.error = "malformed face: " + string(lineStart, end);
+                    break;
+                }
+                // triangulate as a fan, like aiProcess_Triangulate does for convex polygons
+                for (size_t i = 2; i < face.size(); i++)
+                {
+                    chunk.corners.push_back(face[0]);
+                    chunk.corners.push_back(face[i - 1]);
+                    chunk.corners.push_back(face[i]);
+                }
+            }
+            else if (IsKeyword(lineStart, end, "usemtl", 6))
+            {
+                MaterialSwitch materialSwitch;
+                materialSwitch.firstTriangle = chunk.corners.size() / 3;
+                materialSwitch.material = TrimBlanks(lineStart + 6, end);
+                chunk.materialSwitches.push_back(materialSwitch);
+            }
+            else if (IsKeyword(lineStart, end, "mtllib", 6))
+                chunk.materialLibraries.push_back(TrimBlanks(lineStart + 6, end));
+            // o, g, s, l and p statements don't affect the result
+        }
+    }
+
+    static void loadMaterialLibrary(const string &path, map<string, vector<TextureRef>> &materials)
+    {
+        map<string, MaterialMaps> parsed;
+        if (!MaterialLibrary::Read(path, parsed))
+        {
+            cout << "WARNING::OBJ_LOADER:: can't open material library " << path << endl;
+            return;
+        }
+
+        // per material the maps in the order processMesh adds them: diffuse, specular, normal, height, occlusion
+        static const MaterialMapKind kinds[5] = {MATERIAL_MAP_DIFFUSE, MATERIAL_MAP_SPECULAR, MATERIAL_MAP_NORMAL,
+                                                 MATERIAL_MAP_HEIGHT, MATERIAL_MAP_OCCLUSION};
+        static const char *typeNames[5] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height",
+                                           "texture_occlusion"};
+        for (auto &material : parsed)
+        {
+            vector<TextureRef> &textures = materials[material.first];
+            textures.clear();
+            for (int type = 0; type < 5; type++)
+            {
+                for (const string &mapPath : material.second.maps[kinds[type]])
+                {
+                    TextureRef texture;
+                    texture.type = typeNames[type];
+                    texture.path = mapPath;
+                    textures.push_back(texture);
+                }
+            }
+        }
+    }
+
+    // open addressing hash map from a v/vt/vn tuple to the vertex created for it
+    class CornerMap
+    {
+    public:
+        CornerMap() : keys(64), values(64, empty), count(0) {}
+
+        // returns the vertex of the corner, or inserts newValue and returns it if the corner is new
+        unsigned int findOrInsert(const Corner &corner, unsigned int newValue)
+        {
+            if ((count + 1) * 2 > keys.size())
+                grow();
+            size_t mask = keys.size() - 1;
+            for (size_t slot = hash(corner) & mask;; slot = (slot + 1) & mask)
+            {
+                if (values[slot] == empty)
+                {
+                    keys[slot] = corner;
+                    values[slot] = newValue;
+                    count++;
+                    return newValue;
+                }
+                if (keys[slot].position == corner.position && keys[slot].uv == corner.uv && keys[slot].normal == corner.normal)
+                    return values[slot];
+            }
+        }
+
+    private:
+        enum : unsigned int { empty = ~0u };
+        vector<Corner> keys;
+        vector<unsigned int> values;
+        size_t count;
+
+        static size_t hash(const Corner &corner)
+        {
+            uint64_t h = (uint64_t)(uint32_t)corner.position * 0x9E3779B97F4A7C15ULL;
+            h ^= (uint64_t)(uint32_t)corner.uv * 0xC2B2AE3D27D4EB4FULL;
+            h ^= (uint64_t)(uint32_t)corner.normal * 0x165667B19E3779F9ULL;
+            return (size_t)(h ^ (h >> 29));
+        }
+
+        void grow()
+        {
+            vector<Corner> oldKeys;
+            vector<unsigned int> oldValues;
+            oldKeys.swap(keys);
+            oldValues.swap(values);
+            keys.assign(oldKeys.size() * 2, Corner());
+            values.assign(oldValues.size() * 2, empty);
+            count = 0;
+            for (size_t i = 0; i < oldKeys.size(); i++)
+                if (oldValues[i] != empty)
+                    findOrInsert(oldKeys[i], oldValues[i]);
+        }
+    };
+
+    static void buildMeshes(const vector<Chunk> &chunks, const Attributes &attributes,
+                            const map<string, vector<TextureRef>> &materials, vector<MeshData> &result)
+    {
+        // one mesh per material, in the order the materials are first used
+        map<string, size_t> meshOfMaterial;
+        vector<CornerMap> cornerMaps;
+        vector<vector<Corner>> meshCorners;
+        string material;
+        for (const Chunk &chunk : chunks)
+        {
+            size_t triangleCount = chunk.corners.size() / 3;
+            size_t nextSwitch = 0;
+            for (size_t t = 0; t < triangleCount; t++)
+            {
+                while (nextSwitch < chunk.materialSwitches.size() && chunk.materialSwitches[nextSwitch].firstTriangle == t)
+                    material = chunk.materialSwitches[nextSwitch++].material;
+                auto it = meshOfMaterial.find(material);
+                if (it == meshOfMaterial.end())
+                {
+                    it = meshOfMaterial.insert(make_pair(material, result.size())).first;
+                    result.push_back(MeshData());
+                    cornerMaps.push_back(CornerMap());
+                    meshCorners.push_back(vector<Corner>());
+                    auto textures = materials.find(material);
+                    if (textures != materials.end())
+                        result.back().textures = textures->second;
+                }
+                size_t mesh = it->second;
+                for (int k = 0; k < 3; k++)
+                {
+                    const Corner &corner = chunk.corners[t * 3 + k];
+                    unsigned int next = (unsigned int)meshCorners[mesh].size();
+                    unsigned int vertex = cornerMaps[mesh].findOrInsert(corner, next);
+                    if (vertex == next)
+                        meshCorners[mesh].push_back(corner);
+                    result[mesh].indices.push_back(vertex);
+                }
+            }
+            // a switch at the very end of a chunk applies to the next one
+            for (; nextSwitch < chunk.materialSwitches.size(); nextSwitch++)
+                material = chunk.materialSwitches[nextSwitch].material;
+        }
+
+        for (size_t mesh = 0; mesh < result.size(); mesh++)
+            buildVertices(meshCorners[mesh], attributes, result[mesh]);
+    }
+
+    static void buildVertices(const vector<Corner> &corners, const Attributes &attributes, MeshData &mesh)
+    {
+        vector<Vertex> &vertices = mesh.vertices;
+        vertices.resize(corners.size());
+        bool missingNormals = false, hasUVs = false;
+        for (size_t i = 0; i < corners.size(); i++)
+        {
+            Vertex &vertex = vertices[i];
+            vertex.Position = attributes.positions[corners[i].position];
+            vertex.Normal = corners[i].normal >= 0 ? attributes.normals[corners[i].normal] : glm::vec3(0.0f);
+            vertex.TexCoords = corners[i].uv >= 0 ? attributes.uvs[corners[i].uv] : glm::vec2(0.0f, 0.0f);
+            vertex.Tangent = glm::vec3(0.0f);
+            vertex.Bitangent = glm::vec3(0.0f);
+            missingNormals |= corners[i].normal < 0;
+            hasUVs |= corners[i].uv >= 0;
+        }
+
+        const vector<unsigned int> &indices = mesh.indices;
+        if (missingNormals)
+        {
+            // smooth normals for vertices without one: area weighted face normals, shared by all vertices at the same
+            // position (aiProcess_GenSmoothNormals). Positions are compared by value, not by OBJ index, so duplicated
+            // v lines are smoothed together too.
+            vector<unsigned int> positionId = positionIds(vertices);
+            vector<glm::vec3> smooth(vertices.size(), glm::vec3(0.0f));
+            for (size_t t = 0; t + 2 < indices.size(); t += 3)
+            {
+                const glm::vec3 &a = vertices[indices[t]].Position;
+                const glm::vec3 &b = vertices[indices[t + 1]].Position;
+                const glm::vec3 &c = vertices[indices[t + 2]].Position;
+                glm::vec3 faceNormal = glm::cross(b - a, c - a);
+                for (int k = 0; k < 3; k++)
+                    if (corners[indices[t + k]].normal < 0)
+                        smooth[positionId[indices[t + k]]] += faceNormal;
+            }
+            for (size_t i = 0; i < vertices.size(); i++)
+            {
+                if (corners[i].normal >= 0)
+                    continue;
+                glm::vec3 normal = smooth[positionId[i]];
+                float length = glm::length(normal);
+                vertices[i].Normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+            }
+        }
+
+        if (hasUVs)
+        {
+            // tangent space from the unflipped uvs, as aiProcess_CalcTangentSpace runs before aiProcess_FlipUVs
+            for (size_t t = 0; t + 2 < indices.size(); t += 3)
+            {
+                Vertex &a = vertices[indices[t]];
+                Vertex &b = vertices[indices[t + 1]];
+                Vertex &c = vertices[indices[t + 2]];
+                glm::vec3 edge1 = b.Position - a.Position, edge2 = c.Position - a.Position;
+                glm::vec2 duv1 = b.TexCoords - a.TexCoords, duv2 = c.TexCoords - a.TexCoords;
+                float determinant = duv1.x * duv2.y - duv2.x * duv1.y;
+                if (determinant == 0.0f)
+                    continue;
+                float r = 1.0f / determinant;
+                glm::vec3 tangent = (edge1 * duv2.y - edge2 * duv1.y) * r;
+                glm::vec3 bitangent = (edge2 * duv1.x - edge1 * duv2.x) * r;
+                for (Vertex *vertex : {&a, &b, &c})
+                {
+                    vertex->Tangent += tangent;
+                    vertex->Bitangent += bitangent;
+                }
+            }
+            for (Vertex &vertex : vertices)
+            {
+                // make both orthogonal to the normal
+                vertex.Tangent = orthonormalize(vertex.Tangent, vertex.Normal);
+                vertex.Bitangent = orthonormalize(vertex.Bitangent, vertex.Normal);
+            }
+        }
+
+        for (Vertex &vertex : vertices)
+            vertex.TexCoords.y = 1.0f - vertex.TexCoords.y;
+    }
+
+    // numbers the distinct positions, vertices at the same position get the same id (see MeshSimplifier)
+    static vector<unsigned int> positionIds(const vector<Vertex> &vertices)
+    {
+        vector<unsigned int> order(vertices.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = (unsigned int)i;
+        auto less = [&vertices](unsigned int a, unsigned int b) {
+            const glm::vec3 &pa = vertices[a].Position, &pb = vertices[b].Position;
+            if (pa.x != pb.x)
+                return pa.x < pb.x;
+            if (pa.y != pb.y)
+                return pa.y < pb.y;
+            return pa.z < pb.z;
+        };
+        sort(order.begin(), order.end(), less);
+        vector<unsigned int> ids(vertices.size());
+        unsigned int count = 0;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            if (i > 0 && less(order[i - 1], order[i]))
+                count++;
+            ids[order[i]] = count;
+        }
+        return ids;
+    }
+
+    static glm::vec3 orthonormalize(const glm::vec3 &v, const glm::vec3 &normal)
+    {
+        glm::vec3 projected = v - normal * glm::dot(normal, v);
+        float length = glm::length(projected);
+        return length > 0.0f ? projected / length : glm::vec3(0.0f);
+    }
+};
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_extensions.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Cache of linked shader programs in the driver's binary format (glGetProgramBinary/glProgramBinary, GL 4.1 or
+// GL_ARB_get_program_binary), so a warm start skips compiling and linking. The binaries live in a cache directory of
+// their own, cache/programs under the working directory unless SetDirectory says otherwise (see CachePath), and one
+// is used if its key matches: a hash of the sources the program was compiled from and of the GL vendor, renderer and
+// version strings, which change with the GPU or driver.
+// Drivers may still reject a binary (e.g. after an update that kept the version string), Load then returns false and
+// the program is compiled from source and stored again.
+//
+// layout: ProgramCacheHeader, binaryLength bytes of binary
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t binaryFormat;
+    uint64_t key;
+    uint32_t binaryLength;
+    uint32_t reserved;
+};
+
+class ProgramCache
+{
+public:
+    // directory the binaries are read from and written to, created when the first one is stored
+    static const string &Directory()
+    {
+        return directory();
+    }
+
+    // to be called before the first Shader is created
+    static void SetDirectory(const string &path)
+    {
+        directory() = path;
+    }
+
+    // path of the cache file belonging to a program, in the cache directory and named after its fragment shader and a
+    // hash of the paths of all stages and the defines, so every program and permutation of a shader gets one:
+    // cache/programs/room.fs.1f3a9c0e5b7d2468.programcache
+    static string CachePath(const string &vertexPath, const string &fragmentPath, const string &geometryPath = "",
+                            const vector<string> &defines = vector<string>())
+    {
+        vector<string> variantNames;
+        variantNames.push_back(vertexPath);
+        variantNames.push_back(fragmentPath);
+        variantNames.push_back(geometryPath);
+        variantNames.insert(variantNames.end(), defines.begin(), defines.end());
+        char variant[17];
+        snprintf(variant, sizeof(variant), "%016llx", (unsigned long long)hashStrings(variantNames));
+        string name = fragmentPath.substr(fragmentPath.find_last_of("/\\") + 1);
+        return Directory() + "/" + name + "." + variant + ".programcache";
+    }
+
+    // whether the context can hand out and take back program binaries, needs SetGLProcLoader
+    static bool IsSupported()
+    {
+        Functions &gl = functions();
+        return gl.getProgramBinary && gl.programBinary && gl.programParameteri && !gl.formats.empty();
+    }
+
+    // 64 bit FNV-1a over the sources (each with its length, so moving text between them changes the key) and the
+    // strings identifying the driver
+    static uint64_t Key(const vector<string> &sources)
+    {
+        uint64_t hash = hashStrings(sources);
+        const GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+        for (GLenum name : names)
+        {
+            const char *value = (const char *)glGetString(name);
+            hash = hashString(hash, value ? value : "");
+        }
+        return hash;
+    }
+
+    // links program from the binary in the cache file, returns false if there is none for key or the driver rejects it
+    static bool Load(GLuint program, const string &cachePath, uint64_t key)
+    {
+        if (!IsSupported())
+            return false;
+        ifstream in(cachePath, ios::binary);
+        ProgramCacheHeader header;
+        if (!in.read((char *)&header, sizeof(header)) || memcmp(header.magic, "PROGBIN\0", 8) != 0 ||
+            header.version != PROGRAM_CACHE_VERSION || header.key != key || header.binaryLength == 0)
+            return false;
+        // a format the driver no longer lists would only raise GL_INVALID_ENUM
+        const vector<GLint> &formats = functions().formats;
+        if (find(formats.begin(), formats.end(), (GLint)header.binaryFormat) == formats.end())
+            return false;
+        vector<char> binary(header.binaryLength);
+        if (!in.read(binary.data(), binary.size()))
+            return false;
+        functions().programBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        return linked == GL_TRUE;
+    }
+
+    // to be called before linking a program that is going to be stored, some drivers only keep the binary then
+    static void PrepareLink(GLuint program)
+    {
+        if (IsSupported())
+            functions().programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // writes the binary of a linked program to the cache file. Written to a temporary file and renamed, like the mesh
+    // cache, so a crash halfway through never leaves a truncated binary behind.
+    static bool Store(GLuint program, const string &cachePath, uint64_t key)
+    {
+        if (!IsSupported())
+            return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+        vector<char> binary(length);
+        GLsizei written = 0;
+        GLenum format = 0;
+        functions().getProgramBinary(program, length, &written, &format, binary.data());
+        if (written <= 0)
+            return false;
+
+        ProgramCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "PROGBIN\0", 8);
+        header.version = PROGRAM_CACHE_VERSION;
+        header.binaryFormat = format;
+        header.key = key;
+        header.binaryLength = (uint32_t)written;
+        if (!makeDirectories(cachePath.substr(0, cachePath.find_last_of('/'))))
+            return false;
+        string tmpPath = cachePath + ".tmp";
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        out.write((const char *)&header, sizeof(header));
+        out.write(binary.data(), written);
+        out.close();
+        if (!out)
+        {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return rename(tmpPath.c_str(), cachePath.c_str()) == 0;
+    }
+
+private:
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length,
+                                                  GLenum *binaryFormat, void *binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary,
+                                               GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+    struct Functions {
+        GetProgramBinaryProc getProgramBinary = nullptr;
+        ProgramBinaryProc programBinary = nullptr;
+        ProgramParameteriProc programParameteri = nullptr;
+        vector<GLint> formats;   // the binary formats the driver takes
+    };
+
+    // looked up once, the first call needs a current context
+    static Functions &functions()
+    {
+        static Functions gl = [] {
+            Functions loaded;
+            if (!HasGLVersion(4, 1) && !HasGLExtension("GL_ARB_get_program_binary"))
+                return loaded;
+            loaded.getProgramBinary = (GetProgramBinaryProc)GetGLProc("glGetProgramBinary");
+            loaded.programBinary = (ProgramBinaryProc)GetGLProc("glProgramBinary");
+            loaded.programParameteri = (ProgramParameteriProc)GetGLProc("glProgramParameteri");
+            GLint formatCount = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+            loaded.formats.resize(max(formatCount, 0));
+            if (formatCount > 0)
+                glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, loaded.formats.data());
+            return loaded;
+        }();
+        return gl;
+    }
+
+    static string &directory()
+    {
+        static string path = "cache/programs";
+        return path;
+    }
+
+    // creates the directory at path and the ones above it that are missing
+    static bool makeDirectories(const string &path)
+    {
+        if (path.empty())
+            return true;
+        for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1))
+        {
+            string parent = path.substr(0, slash);
+            if (mkdir(parent.c_str(), 0755) != 0 && errno != EEXIST)
+                return false;
+            if (slash == string::npos)
+                return true;
+        }
+    }
+
+    static uint64_t hashStrings(const vector<string> &texts)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (const string &text : texts)
+            hash = hashString(hash, text);
+        return hash;
+    }
+
+    static uint64_t hashString(uint64_t hash, const string &text)
+    {
+        const uint64_t prime = 0x100000001b3ULL;
+        uint64_t length = text.size();
+        for (int i = 0; i < 8; i++)
+            hash = (hash ^ ((length >> (i * 8)) & 0xFF)) * prime;
+        for (unsigned char c : text)
+            hash = (hash ^ c) * prime;
+        return hash;
+    }
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Turns a shader file into the source handed to glShaderSource. GLSL has no #include, so
+//
+//   #include "name"
+//
+// lines are replaced by the named file, looked up next to the including one. Every file is included once, like with
+// #pragma once. The given defines ("NAME" or "NAME value") are inserted right after #version, which has to stay the
+// first line. #line directives keep compile errors pointing at the right line: the file index in them is the order
+// files were first included in, 0 being the shader itself.
+
+inline string shaderDirectory(const string &path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == string::npos ? string() : path.substr(0, slash + 1);
+}
+
+inline bool preprocessShaderFile(const string &path, string &source, set<string> &included, int &fileCount)
+{
+    if (!included.insert(path).second)
+        return true;
+    ifstream in(path);
+    if (!in)
+    {
+        cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << endl;
+        return false;
+    }
+    int fileIndex = fileCount++;
+    if (fileIndex > 0)
+        source += "#line 1 " + to_string(fileIndex) + "\n";
+    string line;
+    for (int number = 1; getline(in, line); number++)
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == string::npos || line.compare(start, 8, "#include") != 0)
+        {
+            source += line;
+            source += '\n';
+            continue;
+        }
+        size_t open = line.find('"', start + 8);
+        size_t close = open == string::npos ? string::npos : line.find('"', open + 1);
+        if (close == string::npos)
+        {
+            cout << "ERROR::SHADER::BAD_INCLUDE " << path << ":" << number << endl;
+            return false;
+        }
+        string includePath = shaderDirectory(path) + line.substr(open + 1, close - open - 1);
+        if (!preprocessShaderFile(includePath, source, included, fileCount))
+            return false;
+        source += "#line " + to_string(number + 1) + " " + to_string(fileIndex) + "\n";
+    }
+    return true;
+}
+
+// the source of the shader file at path with its includes expanded and defines inserted, false if a file can't be read
+inline bool PreprocessShader(const string &path, const vector<string> &defines, string &source)
+{
+    set<string> included;
+    int fileCount = 0;
+    string expanded;
+    if (!preprocessShaderFile(path, expanded, included, fileCount))
+        return false;
+
+    // #version and whatever precedes it (comments, blank lines) stay on top
+    size_t version = expanded.find("#version");
+    size_t insert = version == string::npos ? 0 : expanded.find('\n', version);
+    insert = insert == string::npos ? expanded.size() : insert + 1;
+    int versionLine = 1;
+    for (size_t i = 0; i < insert; i++)
+        versionLine += expanded[i] == '\n';
+    source = expanded.substr(0, insert);
+    if (!defines.empty())
+    {
+        for (const string &define : defines)
+            source += "#define " + define + "\n";
+        source += "#line " + to_string(versionLine) + " 0\n";
+    }
+    source += expanded.substr(insert);
+    return true;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef SHADER_REGISTRY_H
+#define SHADER_REGISTRY_H
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// The programs of the application by shader files and permutation. A permutation is a set of defines the shader's
+// feature flags are switched with (see PreprocessShader), e.g. {"ALPHA_DISCARD"}. Each one is built the first time
+// it is asked for and shared by everyone asking for it after, the order of the defines doesn't matter. Programs live
+// as long as the context, needs a current one.
+class ShaderRegistry
+{
+public:
+    static ShaderRegistry &Instance()
+    {
+        static ShaderRegistry instance;
+        return instance;
+    }
+
+    // the program of the shader files with the given defines ("NAME" or "NAME value")
+    Shader &Get(const string &vertexPath, const string &fragmentPath, vector<string> defines = vector<string>())
+    {
+        sort(defines.begin(), defines.end());
+        defines.erase(unique(defines.begin(), defines.end()), defines.end());
+        string key = vertexPath + '\n' + fragmentPath;
+        for (const string &define : defines)
+            key += '\n' + define;
+        unique_ptr<Shader> &program = programs[key];
+        if (!program)
+            program.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), defines));
+        return *program;
+    }
+
+    // number of distinct programs built
+    size_t ProgramCount() const
+    {
+        return programs.size();
+    }
+
+private:
+    map<string, unique_ptr<Shader>> programs;
+
+    ShaderRegistry() {}
+    ShaderRegistry(const ShaderRegistry &) = delete;
+    ShaderRegistry &operator=(const ShaderRegistry &) = delete;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <learnopengl/gl_state.h>
 
 #include <string>
 #include <fstream>
@@ -77,7 +78,7 @@ public:
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        GLState::Instance().UseProgram(ID);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
@@ -0,0 +1,39 @@
+#ifndef TEXT_SCAN_H
+#define TEXT_SCAN_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+using namespace std;
+
+// Helpers for the line based text formats parsed straight out of a mapped file (OBJ, MTL), on [p, end) ranges that
+// are not null terminated. Blanks are spaces and tabs only, lines end at '\n' and may carry a '\r' before it.
+
+inline bool IsBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+inline const char *SkipBlanks(const char *p, const char *end)
+{
+    while (p < end && IsBlank(*p))
+        p++;
+    return p;
+}
+
+// the range without leading and trailing blanks (and the '\r' of a CRLF line end)
+inline string TrimBlanks(const char *begin, const char *end)
+{
+    begin = SkipBlanks(begin, end);
+    while (end > begin && (IsBlank(end[-1]) || end[-1] == '\r'))
+        end--;
+    return string(begin, end);
+}
+
+// whether a line starts with the keyword, e.g. "vt" for "vt 0.5 0.5". The keyword has to be followed by a blank.
+inline bool IsKeyword(const char *p, const char *end, const char *word, size_t length)
+{
+    return (size_t)(end - p) > length && memcmp(p, word, length) == 0 && IsBlank(p[length]);
+}
+
+#endif
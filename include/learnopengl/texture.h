@@ -0,0 +1,293 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <sys/stat.h>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/image_decoder.h>
+#include <learnopengl/ktx.h>
+#include <learnopengl/mip_chain.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Texture loading is split in two halves: decoding an image file into texels, which only touches the CPU and can run
+// on any thread, and uploading the texels into a GL texture, which has to happen on the thread owning the GL context.
+//
+// Decoding also builds the mip chain on the CPU (see mip_chain.h) and stores the texels of every level in a decoded
+// texture cache next to the image (plocice.png -> plocice.png.texcache), an uncompressed KTX file. Later runs map that
+// file and upload the levels straight from the mapping, no decode and no glGenerateMipmap. The cache holds the texels
+// as the decoder returned them and records the vertical flip they were decoded with, a cache written with the other
+// flip (e.g. by texture_baker --no-flip) is decoded again.
+
+// Images can also be baked offline (tools/texture_baker) into block compressed KTX files next to them. Those skip the
+// decode and the mip generation entirely and are uploaded as they are.
+
+// decoded texels of one image file
+struct TextureImage {
+    string path;
+    unsigned char *data = nullptr;      // level 0 as decoded
+    const ImageDecoder *decoder = nullptr;  // the backend that decoded data, it frees it
+    int width = 0;
+    int height = 0;
+    int nrComponents = 0;
+    vector<vector<uint8_t>> mipLevels;  // levels 1 and up
+    shared_ptr<KtxFile> cached;         // instead of the above if the decoded texture cache was up to date
+
+    bool Decoded() const
+    {
+        return data != nullptr || cached != nullptr;
+    }
+};
+
+// path of the decoded texture cache of an image
+inline string DecodedTextureCachePath(const string &imagePath)
+{
+    return imagePath + ".texcache";
+}
+
+// name of the mip filter, stored in the cache so a file built with the other one isn't used
+inline const char *MipFilterName(bool srgb)
+{
+    return srgb ? "box, srgb" : "box, linear";
+}
+
+// value of the flipVertically key of the cache, for the current SetImageFlipVertically
+inline const char *FlipVerticallyValue()
+{
+    return ImageFlipVertically() ? "true" : "false";
+}
+
+// maps the decoded texture cache of an image if it is at least as new as the image and was built with the same filter
+// and vertical flip
+inline bool OpenDecodedTextureCache(const string &imagePath, bool srgb, TextureImage &image)
+{
+    struct stat cache, source;
+    string cachePath = DecodedTextureCachePath(imagePath);
+    if (stat(cachePath.c_str(), &cache) != 0 || stat(imagePath.c_str(), &source) != 0 || cache.st_mtime < source.st_mtime)
+        return false;
+    shared_ptr<KtxFile> ktx = make_shared<KtxFile>();
+    if (!ktx->Open(cachePath))
+        return false;
+    const KtxHeader &header = ktx->Header();
+    if (header.glType != GL_UNSIGNED_BYTE || ktx->Value("mipFilter") != MipFilterName(srgb) ||
+        ktx->Value("flipVertically") != FlipVerticallyValue() ||
+        (int)ktx->Levels() != MipLevelCount(header.pixelWidth, header.pixelHeight))
+        return false;
+    image.width = header.pixelWidth;
+    image.height = header.pixelHeight;
+    image.nrComponents = header.glFormat == GL_RED ? 1 : header.glFormat == GL_RG ? 2 : header.glFormat == GL_RGB ? 3 : 4;
+    image.cached = ktx;
+    return true;
+}
+
+// writes the texels of all levels of a decoded image to its cache
+inline bool WriteDecodedTextureCache(const TextureImage &image, bool srgb)
+{
+    static const GLenum formats[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    static const GLenum internalFormats[4] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+    if (image.nrComponents < 1 || image.nrComponents > 4)
+        return false;
+    vector<KtxLevel> levels;
+    levels.push_back(KtxUncompressedLevel(image.data, image.width, image.height, image.nrComponents));
+    int width = image.width, height = image.height;
+    for (const vector<uint8_t> &level : image.mipLevels)
+    {
+        width = max(1, width / 2);
+        height = max(1, height / 2);
+        levels.push_back(KtxUncompressedLevel(level.data(), width, height, image.nrComponents));
+    }
+    GLenum format = formats[image.nrComponents - 1];
+    return KtxFile::Write(DecodedTextureCachePath(image.path), GL_UNSIGNED_BYTE, 1, format,
+                          internalFormats[image.nrComponents - 1], format, image.width, image.height, levels,
+                          {make_pair(string("mipFilter"), string(MipFilterName(srgb))),
+                           make_pair(string("flipVertically"), string(FlipVerticallyValue()))});
+}
+
+// decodes the image at path and builds its mip chain, or maps its decoded texture cache when that is up to date.
+// srgb tells whether the RGB channels hold colors (diffuse maps) or data (normal, specular and height maps), see
+// mip_chain.h. Safe to call from worker threads. Returns false if the file couldn't be decoded.
+inline bool DecodeTextureImage(const string &path, TextureImage &image, bool srgb = true)
+{
+    image.path = path;
+    if (OpenDecodedTextureCache(path, srgb, image))
+        return true;
+    image.data = DecodeImage(path, image.width, image.height, image.nrComponents, image.decoder);
+    if (!image.data)
+        return false;
+    image.mipLevels = BuildMipChain(image.data, image.width, image.height, image.nrComponents, srgb);
+    if (!WriteDecodedTextureCache(image, srgb))
+        std::cout << "WARNING::TEXTURE:: failed to write " << DecodedTextureCachePath(path) << std::endl;
+    return true;
+}
+
+inline void FreeTextureImage(TextureImage &image)
+{
+    FreeImage(image.data, image.decoder);
+    image.data = nullptr;
+    image.decoder = nullptr;
+    image.mipLevels.clear();
+    image.cached.reset();
+}
+
+// creates a repeating, trilinear filtered GL texture from the levels of a KTX file, compressed or not. Must be called
+// on the GL context thread.
+inline unsigned int UploadKtxTexture(const KtxFile &ktx)
+{
+    const KtxHeader &header = ktx.Header();
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    GLState::Instance().BindTexture(GL_TEXTURE_2D, textureID);
+    for (size_t level = 0; level < ktx.Levels(); level++)
+    {
+        GLsizei width = max(1u, header.pixelWidth >> level), height = max(1u, header.pixelHeight >> level);
+        if (header.glType == 0)
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, header.glInternalFormat, width, height, 0,
+                                   (GLsizei)ktx.LevelSize(level), ktx.LevelData(level));
+        else
+        {
+            // KTX rows are padded to 4 bytes
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, header.glInternalFormat, width, height, 0, header.glFormat,
+                         header.glType, ktx.LevelData(level));
+        }
+    }
+    // only the levels in the file, a chain that stops early must not make the texture incomplete
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)ktx.Levels() - 1);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
+// creates a mipmapped, repeating GL texture from decoded texels. Must be called on the GL context thread.
+inline unsigned int UploadTextureImage(const TextureImage &image)
+{
+    if (image.cached)
+        return UploadKtxTexture(*image.cached);
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    if (!image.data)
+        return textureID;
+
+    GLenum format = GL_RGB;
+    if (image.nrComponents == 1)
+        format = GL_RED;
+    else if (image.nrComponents == 2)
+        format = GL_RG;
+    else if (image.nrComponents == 3)
+        format = GL_RGB;
+    else if (image.nrComponents == 4)
+        format = GL_RGBA;
+
+    GLState::Instance().BindTexture(GL_TEXTURE_2D, textureID);
+    // decoded and mip chain rows are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+    int width = image.width, height = image.height;
+    for (size_t level = 0; level < image.mipLevels.size(); level++)
+    {
+        width = max(1, width / 2);
+        height = max(1, height / 2);
+        glTexImage2D(GL_TEXTURE_2D, (GLint)level + 1, format, width, height, 0, format, GL_UNSIGNED_BYTE,
+                     image.mipLevels[level].data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (image.mipLevels.empty())
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
+// path of the baked version of an image, e.g. plocice.png -> plocice.png.ktx
+inline string BakedTexturePath(const string &imagePath)
+{
+    return imagePath + ".ktx";
+}
+
+// whether a baked version of the image exists that is at least as new as the image. Only looks at the file system,
+// so it is safe on worker threads, LoadBakedTexture can still fail if the GL doesn't support its format.
+inline bool HasBakedTexture(const string &imagePath)
+{
+    struct stat baked, image;
+    if (stat(BakedTexturePath(imagePath).c_str(), &baked) != 0)
+        return false;
+    return stat(imagePath.c_str(), &image) != 0 || baked.st_mtime >= image.st_mtime;
+}
+
+// maps the baked KTX file of an image. Returns nullptr if there is no up to date baked file or its format isn't
+// supported, the caller then loads the image itself.
+inline shared_ptr<KtxFile> OpenBakedTexture(const string &imagePath)
+{
+    if (!HasBakedTexture(imagePath))
+        return nullptr;
+    shared_ptr<KtxFile> ktx = make_shared<KtxFile>();
+    if (!ktx->Open(BakedTexturePath(imagePath)))
+    {
+        std::cout << "WARNING::TEXTURE:: invalid baked texture " << BakedTexturePath(imagePath) << std::endl;
+        return nullptr;
+    }
+    if (!IsTextureFormatSupported(ktx->Header().glInternalFormat))
+        return nullptr;
+    return ktx;
+}
+
+// creates a GL texture from the baked KTX file of an image, uploading its compressed mip chain as it is. Returns 0 if
+// OpenBakedTexture fails.
+inline unsigned int LoadBakedTexture(const string &imagePath)
+{
+    shared_ptr<KtxFile> ktx = OpenBakedTexture(imagePath);
+    return ktx ? UploadKtxTexture(*ktx) : 0;
+}
+
+// decodes all given files on a pool of worker threads, one image per task. The result is in the same order as paths,
+// entries that failed to decode aren't Decoded(). maxThreads == 0 uses one thread per hardware thread. If given,
+// decodedCount is incremented after every image, so other threads can follow the progress. srgb is parallel to paths,
+// if empty every image is treated as a color image.
+inline vector<TextureImage> DecodeTextureImagesParallel(const vector<string> &paths, unsigned int maxThreads = 0,
+                                                 atomic<size_t> *decodedCount = nullptr, const vector<bool> &srgb = {})
+{
+    vector<TextureImage> images(paths.size());
+    if (paths.empty())
+        return images;
+
+    unsigned int threadCount = maxThreads ? maxThreads : thread::hardware_concurrency();
+    threadCount = max(1u, min(threadCount, (unsigned int)paths.size()));
+
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < paths.size(); i = next++)
+        {
+            DecodeTextureImage(paths[i], images[i], srgb.empty() || srgb[i]);
+            if (decodedCount)
+                (*decodedCount)++;
+        }
+    };
+
+    // the calling thread takes part in the work as well
+    vector<thread> workers;
+    for (unsigned int i = 1; i < threadCount; i++)
+        workers.emplace_back(worker);
+    worker();
+    for (thread &t : workers)
+        t.join();
+    return images;
+}
+
+#endif
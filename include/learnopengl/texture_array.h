@@ -0,0 +1,238 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mip_chain.h>
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_cache.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Packs the textures of a set of materials into the layers of one GL_TEXTURE_2D_ARRAY, so everything using them is
+// drawn with a single texture bind and picks its texture with a layer index instead. Every layer has the same size,
+// the largest width and height among the images, and is RGBA. Images of that size take the mip chain
+// DecodeTextureImage built (or mapped from the decoded texture cache) as it is, only expanded to RGBA; smaller ones
+// are resampled bilinearly and get a mip chain of their own.
+//
+// The array is shared through the TextureCache under a key made of the canonical paths of its layers, so building the
+// same set of textures again takes a reference to the resident array instead of decoding anything, and Release gives
+// it back.
+//
+//     TextureArrayBuilder builder;
+//     int tiles = builder.Add("resources/textures/plocice.png");
+//     builder.Build();
+//     ...
+//     builder.Bind(0);
+//     shader.setInt("material.texture", tiles);
+//     ...
+//     builder.Release();
+class TextureArrayBuilder
+{
+public:
+    // queues an image, returns its layer. Adding the same path twice returns the layer it already has.
+    int Add(const string &path)
+    {
+        for (size_t i = 0; i < paths.size(); i++)
+            if (paths[i] == path)
+                return (int)i;
+        paths.push_back(path);
+        return (int)paths.size() - 1;
+    }
+
+    int Layers() const
+    {
+        return (int)paths.size();
+    }
+
+    // decodes the queued images (in parallel) and creates the array with full mip chains, or takes the one in the
+    // TextureCache. srgb applies to all layers, see mip_chain.h. Images that fail to decode leave their layer
+    // transparent black. Takes a reference. Must be called on the GL context thread.
+    unsigned int Build(bool srgb = true)
+    {
+        string key = cacheKey(srgb);
+        if (TextureCache::Instance().TryAcquireArray(key, texture))
+            return texture;
+
+        vector<TextureImage> images = DecodeTextureImagesParallel(paths, 0, nullptr, vector<bool>(paths.size(), srgb));
+        width = height = 0;
+        for (const TextureImage &image : images)
+        {
+            if (!image.Decoded())
+                std::cout << "Texture failed to load at path: " << image.path << std::endl;
+            else
+            {
+                width = max(width, image.width);
+                height = max(height, image.height);
+            }
+        }
+        width = max(width, 1);
+        height = max(height, 1);
+
+        texture = createArray(width, height, (int)images.size());
+        vector<uint8_t> layer((size_t)width * height * 4);
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            if (images[i].Decoded() && images[i].width == width && images[i].height == height)
+                uploadLayer(images[i], (int)i);
+            else
+            {
+                fill(layer.begin(), layer.end(), 0);
+                if (images[i].Decoded())
+                    resampleToRGBA(images[i], layer.data(), width, height);
+                uploadResampledLayer(layer.data(), width, height, (int)i, srgb);
+            }
+            FreeTextureImage(images[i]);
+        }
+        texture = TextureCache::Instance().InsertArray(key, texture, levelBytes((int)images.size()));
+        return texture;
+    }
+
+    // gives back the reference Build took, the array must not be bound afterwards
+    void Release()
+    {
+        if (texture)
+            TextureCache::Instance().Release(texture);
+        texture = 0;
+    }
+
+    // binds the array to a texture unit
+    void Bind(GLuint unit) const
+    {
+        GLState::Instance().BindTexture(unit, GL_TEXTURE_2D_ARRAY, texture);
+    }
+
+private:
+    vector<string> paths;
+    int width = 0, height = 0;   // of every layer, after Build
+    unsigned int texture = 0;
+
+    // names the array in the TextureCache: its layers in order and the mip filter
+    string cacheKey(bool srgb) const
+    {
+        string key = string("array:") + MipFilterName(srgb);
+        for (const string &path : paths)
+            key += "|" + TextureCache::CanonicalPath(path);
+        return key;
+    }
+
+    // GPU bytes of every level of the array
+    vector<size_t> levelBytes(int layers) const
+    {
+        vector<size_t> bytes;
+        int levels = MipLevelCount(width, height);
+        for (int level = 0, w = width, h = height; level < levels; level++, w = max(1, w / 2), h = max(1, h / 2))
+            bytes.push_back((size_t)w * h * 4 * layers);
+        return bytes;
+    }
+
+    static unsigned int createArray(int width, int height, int layers)
+    {
+        int levels = MipLevelCount(width, height);
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        GLState::Instance().BindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+        for (int level = 0, w = width, h = height; level < levels; level++, w = max(1, w / 2), h = max(1, h / 2))
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA, w, h, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return textureID;
+    }
+
+    // uploads every level of a decoded image of the layer size into a layer of the bound array, expanded to RGBA.
+    // Missing channels are filled like GL does when it expands a GL_RED/GL_RG/GL_RGB texture.
+    static void uploadLayer(const TextureImage &image, int layer)
+    {
+        int channels = image.nrComponents;
+        int levels = MipLevelCount(image.width, image.height);
+        vector<uint8_t> rgba((size_t)image.width * image.height * 4);
+        for (int level = 0, w = image.width, h = image.height; level < levels; level++, w = max(1, w / 2), h = max(1, h / 2))
+        {
+            const uint8_t *texels;
+            size_t rowBytes = (size_t)w * channels;
+            if (image.cached)
+            {
+                texels = image.cached->LevelData(level);
+                // the decoded texture cache pads its rows to 4 bytes
+                rowBytes = (rowBytes + 3) & ~(size_t)3;
+            }
+            else if (level == 0)
+                texels = image.data;
+            else if ((size_t)level <= image.mipLevels.size())
+                texels = image.mipLevels[level - 1].data();
+            else
+                break;
+
+            for (int y = 0; y < h; y++)
+            {
+                const uint8_t *in = texels + y * rowBytes;
+                uint8_t *out = rgba.data() + (size_t)y * w * 4;
+                for (int x = 0; x < w; x++)
+                    for (int c = 0; c < 4; c++)
+                        out[x * 4 + c] = c < channels ? in[x * channels + c] : (c == 3 ? 255 : 0);
+            }
+            // RGBA rows are 4 byte aligned anyway
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+        }
+    }
+
+    // uploads resampled RGBA texels and the mip chain built from them into a layer of the bound array
+    static void uploadResampledLayer(const uint8_t *texels, int width, int height, int layer, bool srgb)
+    {
+        vector<vector<uint8_t>> mipLevels = BuildMipChain(texels, width, height, 4, srgb);
+        int levels = MipLevelCount(width, height);
+        for (int level = 0, w = width, h = height; level < levels; level++, w = max(1, w / 2), h = max(1, h / 2))
+        {
+            const uint8_t *levelTexels = level == 0 ? texels : mipLevels[level - 1].data();
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, levelTexels);
+        }
+    }
+
+    // level 0 of a decoded image resampled bilinearly to width x height, as RGBA. Missing channels are filled like GL
+    // does when it expands a GL_RED/GL_RG/GL_RGB texture.
+    static void resampleToRGBA(const TextureImage &image, uint8_t *out, int width, int height)
+    {
+        int channels = image.nrComponents;
+        const uint8_t *texels = image.cached ? image.cached->LevelData(0) : image.data;
+        // the decoded texture cache pads its rows to 4 bytes
+        size_t rowBytes = (size_t)image.width * channels;
+        if (image.cached)
+            rowBytes = (rowBytes + 3) & ~(size_t)3;
+
+        float scaleX = (float)image.width / width, scaleY = (float)image.height / height;
+        for (int y = 0; y < height; y++)
+        {
+            float sy = max(0.0f, (y + 0.5f) * scaleY - 0.5f);
+            int y0 = min((int)sy, image.height - 1), y1 = min(y0 + 1, image.height - 1);
+            float fy = sy - y0;
+            for (int x = 0; x < width; x++)
+            {
+                float sx = max(0.0f, (x + 0.5f) * scaleX - 0.5f);
+                int x0 = min((int)sx, image.width - 1), x1 = min(x0 + 1, image.width - 1);
+                float fx = sx - x0;
+                uint8_t *texel = out + ((size_t)y * width + x) * 4;
+                for (int c = 0; c < 4; c++)
+                {
+                    if (c >= channels)
+                    {
+                        texel[c] = c == 3 ? 255 : 0;
+                        continue;
+                    }
+                    float top = texels[y0 * rowBytes + x0 * channels + c] * (1.0f - fx) + texels[y0 * rowBytes + x1 * channels + c] * fx;
+                    float bottom = texels[y1 * rowBytes + x0 * channels + c] * (1.0f - fx) + texels[y1 * rowBytes + x1 * channels + c] * fx;
+                    texel[c] = (uint8_t)(top * (1.0f - fy) + bottom * fy + 0.5f);
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,549 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+#include <unistd.h>
+
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_uploader.h>
+
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Process wide cache of GL textures keyed by the canonical path of the image file, so every image is decoded and
+// resident only once no matter how many models or loaders use it. Texture arrays (see TextureArrayBuilder) are kept
+// under a key naming all their layers. Every Acquire/Insert takes a reference that has to be given back with Release. Unreferenced textures stay resident (a model loaded right after may want them again)
+// until they are explicitly evicted with EvictUnused, or by the residency budget.
+//
+// Residency: the cache knows the GPU bytes of every level of its textures and when each texture was last drawn (Touch,
+// which Mesh::Draw calls). Update, once per frame, keeps the total under the budget: it first deletes unreferenced
+// textures, then drops the largest level of referenced streamed ones that weren't drawn for a while, least recently
+// used first. A dropped level is respecified empty, which frees its memory, and GL_TEXTURE_BASE_LEVEL moves past it, so
+// the texture id stays valid and the texture just gets blurrier.
+//
+// Streaming is opt-in: only textures acquired with streamed = true, by owners that Touch them on every draw (Model
+// does), are streamed, and only if they have a baked or decoded texture cache file to load their levels from. They are
+// created with only their small levels (up to STREAM_START_SIZE). Every draw tells Touch how many UV units one pixel of
+// the mesh covers on screen, which gives the largest level that draw can sample. Update streams the levels down to the
+// largest one asked for in the last frame in through the TextureUploader, and until they arrive GL_TEXTURE_BASE_LEVEL
+// keeps sampling to the resident ones. Levels finer than what is drawn are the first to go when over the budget. All
+// other textures are fully resident for as long as they are referenced; a texture that was streamed and gets acquired
+// without streaming streams all its levels back in and stays complete.
+//
+// Pinned textures: everything that isn't streamed, including texture arrays, keeps all its levels while it is
+// referenced. Its bytes still count against the budget, so the streamed textures give way to them, and it is deleted
+// like any other texture once unreferenced. PinnedBytes tells how much of the budget that takes.
+class TextureCache
+{
+public:
+    static TextureCache &Instance()
+    {
+        static TextureCache instance;
+        return instance;
+    }
+
+    // absolute path with symlinks, '.' and '..' resolved. Paths that don't exist are used as given.
+    static string CanonicalPath(const string &path)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved))
+            return string(resolved);
+        return path;
+    }
+
+    // returns the texture for the image at path, loading it on first use (from its baked KTX file if there is one,
+    // decoding the image otherwise). srgb is passed on to DecodeTextureImage. Takes a reference. The texels are
+    // uploaded by the TextureUploader over the next frames. streamed is for callers that Touch the texture on every
+    // draw, see above.
+    unsigned int Acquire(const string &path, bool srgb = true, bool streamed = false)
+    {
+        string key = CanonicalPath(path);
+        unsigned int id;
+        if (tryAcquireCanonical(key, streamed, id))
+            return id;
+
+        TextureImage image;
+        image.path = path;
+        image.cached = OpenBakedTexture(path);
+        if (!image.cached && !DecodeTextureImage(path, image, srgb))
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+        return Insert(key, image, srgb, streamed);
+    }
+
+    // takes a reference to the texture at path if it is already resident, never loads anything
+    bool TryAcquire(const string &path, unsigned int &id, bool streamed = false)
+    {
+        return tryAcquireCanonical(CanonicalPath(path), streamed, id);
+    }
+
+    // whether the texture at path is resident, doesn't take a reference
+    bool Contains(const string &path) const
+    {
+        return entries.count(CanonicalPath(path)) != 0;
+    }
+
+    // registers a texture that was uploaded elsewhere (e.g. after a parallel decode) and takes a reference to it.
+    // If the path got cached in the meantime the given texture is deleted and the cached one is returned instead.
+    // srgb is what the texture was decoded with, levels restored after dropping them have to be the same.
+    unsigned int Insert(const string &path, unsigned int id, bool srgb = true, bool streamed = false)
+    {
+        string key = CanonicalPath(path);
+        auto it = entries.find(key);
+        if (it != entries.end())
+        {
+            if (it->second.id != id)
+            {
+                TextureUploader::Instance().Cancel(id);
+                GLState::Instance().DeleteTextures(1, &id);
+            }
+            unsigned int cached;
+            tryAcquireCanonical(key, streamed, cached);
+            return cached;
+        }
+        Entry entry;
+        entry.id = id;
+        entry.refCount = 1;
+        entry.srgb = srgb;
+        measureLevels(id, entry);
+        entry.streamable = isStreamable(key);
+        entry.streamed = streamed;
+        entry.lastUsed = frame;
+        for (size_t bytes : entry.levelBytes)
+            residentBytes += bytes;
+        entries[key] = entry;
+        paths[id] = key;
+        return id;
+    }
+
+    // uploads decoded texels (or a mapped baked or decoded texture cache file, in image.cached) and takes a reference
+    // to the texture, like Acquire does for a path. Streamed textures get only their small levels at first. If the
+    // path is already cached that texture is returned and image is just freed.
+    unsigned int Insert(const string &path, TextureImage &image, bool srgb = true, bool streamed = false)
+    {
+        string key = CanonicalPath(path);
+        unsigned int id;
+        if (tryAcquireCanonical(key, streamed, id))
+        {
+            FreeTextureImage(image);
+            return id;
+        }
+        Entry entry;
+        entry.refCount = 1;
+        entry.srgb = srgb;
+        imageLevels(image, entry);
+        entry.streamable = isStreamable(key);
+        entry.streamed = streamed;
+        entry.lastUsed = frame;
+        if (entry.streamed && entry.streamable)
+            while (entry.baseLevel + 1 < entry.levelBytes.size() && (entry.size >> entry.baseLevel) > STREAM_START_SIZE)
+                entry.baseLevel++;
+        entry.wantedLevel = entry.baseLevel;
+        entry.id = TextureUploader::Instance().Upload(image, entry.baseLevel);
+        for (size_t level = entry.baseLevel; level < entry.levelBytes.size(); level++)
+            residentBytes += entry.levelBytes[level];
+        entries[key] = entry;
+        paths[entry.id] = key;
+        return entry.id;
+    }
+
+    // takes a reference to the texture array registered under key if it is resident
+    bool TryAcquireArray(const string &key, unsigned int &id)
+    {
+        return tryAcquireCanonical(key, false, id);
+    }
+
+    // registers a texture array built elsewhere under key, with the GPU bytes of every level of all its layers, and
+    // takes a reference to it. If the key got cached in the meantime the given array is deleted and the cached one is
+    // returned instead.
+    unsigned int InsertArray(const string &key, unsigned int id, const vector<size_t> &levelBytes)
+    {
+        unsigned int cached;
+        if (tryAcquireCanonical(key, false, cached))
+        {
+            if (cached != id)
+                GLState::Instance().DeleteTextures(1, &id);
+            return cached;
+        }
+        Entry entry;
+        entry.id = id;
+        entry.refCount = 1;
+        entry.levelBytes = levelBytes;
+        entry.lastUsed = frame;
+        for (size_t bytes : entry.levelBytes)
+            residentBytes += bytes;
+        entries[key] = entry;
+        paths[id] = key;
+        return id;
+    }
+
+    // gives back one reference. The texture stays resident until EvictUnused is called.
+    void Release(unsigned int id)
+    {
+        auto path = paths.find(id);
+        if (path == paths.end())
+            return;
+        Entry &entry = entries[path->second];
+        if (entry.refCount > 0)
+            entry.refCount--;
+    }
+
+    void Release(const string &path)
+    {
+        auto it = entries.find(CanonicalPath(path));
+        if (it != entries.end() && it->second.refCount > 0)
+            it->second.refCount--;
+    }
+
+    // deletes every texture nobody holds a reference to, returns how many were deleted
+    size_t EvictUnused()
+    {
+        size_t evicted = 0;
+        for (auto it = entries.begin(); it != entries.end();)
+        {
+            if (it->second.refCount == 0)
+            {
+                it = evict(it);
+                evicted++;
+            }
+            else
+                ++it;
+        }
+        return evicted;
+    }
+
+    size_t Size() const
+    {
+        return entries.size();
+    }
+
+    // marks the texture as drawn this frame. uvPerPixel is how many UV units one screen pixel of the draw covers at
+    // most, which picks the largest level it needs: a 1024 texel texture drawn with 1/256 UV per pixel only needs
+    // level 2. 0 asks for all levels. Missing levels are streamed in by the next Update.
+    void Touch(unsigned int id, float uvPerPixel = 0.0f)
+    {
+        auto path = paths.find(id);
+        if (path == paths.end())
+            return;
+        Entry &entry = entries[path->second];
+        unsigned int level = 0;
+        float texelsPerPixel = entry.size * uvPerPixel;
+        if (texelsPerPixel > 1.0f && !entry.levelBytes.empty())
+            level = (unsigned int)min(log2f(texelsPerPixel), (float)entry.levelBytes.size() - 1.0f);
+        if (entry.lastUsed != frame || level < entry.wantedLevel)
+            entry.wantedLevel = level;
+        entry.lastUsed = frame;
+    }
+
+    // GPU memory the textures may use, 0 for no limit
+    void SetBudget(size_t bytes)
+    {
+        budgetBytes = bytes;
+    }
+
+    size_t Budget() const
+    {
+        return budgetBytes;
+    }
+
+    // GPU bytes of all resident levels
+    size_t ResidentBytes() const
+    {
+        return residentBytes;
+    }
+
+    // GPU bytes of referenced textures whose levels are never dropped, see above
+    size_t PinnedBytes() const
+    {
+        size_t pinned = 0;
+        for (const auto &it : entries)
+        {
+            const Entry &entry = it.second;
+            if (entry.refCount == 0 || (entry.streamed && entry.streamable))
+                continue;
+            for (size_t level = entry.baseLevel; level < entry.levelBytes.size(); level++)
+                pinned += entry.levelBytes[level];
+        }
+        return pinned;
+    }
+
+    // number of levels not resident across all textures, dropped or not streamed in yet
+    size_t DroppedLevels() const
+    {
+        size_t dropped = 0;
+        for (const auto &entry : entries)
+            dropped += entry.second.baseLevel;
+        return dropped;
+    }
+
+    // streams in the levels the last frame asked for (all of them for textures that aren't streamed), starts a new
+    // frame and brings the resident bytes under the budget. Call once per frame on the GL thread.
+    void Update()
+    {
+        for (auto &it : entries)
+        {
+            Entry &entry = it.second;
+            unsigned int level = !entry.streamed ? 0 : entry.lastUsed == frame ? entry.wantedLevel : entry.baseLevel;
+            if (entry.streamable && level < entry.baseLevel && !TextureUploader::Instance().IsPending(entry.id))
+                streamLevels(it.first, entry, level);
+        }
+        frame++;
+        if (budgetBytes == 0)
+            return;
+        while (residentBytes > budgetBytes)
+        {
+            // unreferenced idle textures are deleted first, then referenced ones lose their largest level: those with
+            // levels finer than their draws need first, then the least recently used idle ones
+            auto victim = entries.end();
+            int victimRank = 0;
+            for (auto it = entries.begin(); it != entries.end(); ++it)
+            {
+                const Entry &entry = it->second;
+                if (TextureUploader::Instance().IsPending(entry.id))
+                    continue;
+                bool idle = frame - entry.lastUsed >= IDLE_FRAMES;
+                int rank = 0;
+                if (entry.refCount == 0)
+                    rank = idle ? 3 : 0;
+                else if (canDrop(entry))
+                    rank = entry.baseLevel < entry.wantedLevel ? 2 : idle ? 1 : 0;
+                if (rank > victimRank || (rank == victimRank && rank > 0 && entry.lastUsed < victim->second.lastUsed))
+                {
+                    victim = it;
+                    victimRank = rank;
+                }
+            }
+            if (victim == entries.end())
+            {
+                // everything left is in use, the working set is larger than the budget
+                if (!overBudgetReported)
+                    std::cout << "WARNING::TEXTURE_CACHE:: textures in use need " << residentBytes / (1024 * 1024)
+                              << " MB, over the budget of " << budgetBytes / (1024 * 1024) << " MB" << std::endl;
+                overBudgetReported = true;
+                return;
+            }
+            if (victim->second.refCount == 0)
+                evict(victim);
+            else
+                dropLevel(victim->second);
+        }
+        overBudgetReported = false;
+    }
+
+private:
+    struct Entry {
+        unsigned int id = 0;
+        unsigned int refCount = 0;
+        bool srgb = true;
+        vector<size_t> levelBytes;   // GPU bytes of every level, level 0 first
+        unsigned int baseLevel = 0;  // the levels before it are dropped
+        uint64_t lastUsed = 0;       // frame the texture was last drawn in
+        int size = 0;                // larger dimension of level 0
+        unsigned int wantedLevel = 0;  // largest level the draws of frame lastUsed need
+        bool streamable = false;     // has a file its levels can be streamed in from
+        bool streamed = false;       // all its owners Touch it, its levels follow the draws
+        GLenum internalFormat = GL_RGBA8;  // of all its levels, dropped ones are respecified empty in it
+        bool compressed = false;
+    };
+    // frames a texture has to go undrawn before its levels are dropped, so the textures of the current view never are
+    enum { IDLE_FRAMES = 120 };
+    // levels are dropped down to this size at most, smaller textures aren't worth the streaming
+    enum { MIN_RESIDENT_SIZE = 64 };
+    // streamable textures start out with their levels of at most this size, the larger ones are streamed in on demand
+    enum { STREAM_START_SIZE = 128 };
+
+    unordered_map<string, Entry> entries;   // canonical path -> texture
+    unordered_map<unsigned int, string> paths; // texture id -> canonical path, for Release by id
+    size_t budgetBytes = 0;
+    size_t residentBytes = 0;
+    uint64_t frame = 0;
+    bool overBudgetReported = false;
+
+    TextureCache() {}
+    TextureCache(const TextureCache &) = delete;
+    TextureCache &operator=(const TextureCache &) = delete;
+
+    unordered_map<string, Entry>::iterator evict(unordered_map<string, Entry>::iterator it)
+    {
+        Entry &entry = it->second;
+        TextureUploader::Instance().Cancel(entry.id);
+        GLState::Instance().DeleteTextures(1, &entry.id);
+        for (size_t level = entry.baseLevel; level < entry.levelBytes.size(); level++)
+            residentBytes -= entry.levelBytes[level];
+        paths.erase(entry.id);
+        return entries.erase(it);
+    }
+
+    // GPU bytes of every level of a texture, from its level sizes and formats, and the format of its levels. RGB8 is
+    // counted as 4 bytes per texel, drivers store it padded.
+    static void measureLevels(unsigned int id, Entry &entry)
+    {
+        entry.size = 0;
+        vector<size_t> &levelBytes = entry.levelBytes;
+        levelBytes.clear();
+        GLState::Instance().BindTexture(GL_TEXTURE_2D, id);
+        GLint maxLevel = 0;
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        for (GLint level = 0; level <= min(maxLevel, 16); level++)
+        {
+            GLint width = 0, height = 0, compressed = 0, format = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+            if (width == 0 || height == 0)
+                break;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_INTERNAL_FORMAT, &format);
+            if (level == 0)
+            {
+                entry.size = max(width, height);
+                entry.internalFormat = (GLenum)format;
+                entry.compressed = compressed != 0;
+            }
+            GLint bytes = 0;
+            if (compressed)
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &bytes);
+            else
+            {
+                int texelBytes = format == GL_R8 || format == GL_RED ? 1 : format == GL_RG8 || format == GL_RG ? 2 : 4;
+                bytes = width * height * texelBytes;
+            }
+            levelBytes.push_back((size_t)bytes);
+        }
+    }
+
+    // GPU bytes of every level of the texture created from image, counted like measureLevels does, and the format
+    // TextureUploader creates its levels in
+    static void imageLevels(const TextureImage &image, Entry &entry)
+    {
+        static const GLenum internalFormats[4] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+        vector<size_t> &levelBytes = entry.levelBytes;
+        levelBytes.clear();
+        entry.size = 0;
+        if (image.cached)
+        {
+            const KtxHeader &header = image.cached->Header();
+            entry.size = (int)max(header.pixelWidth, header.pixelHeight);
+            entry.internalFormat = header.glInternalFormat;
+            entry.compressed = header.glType == 0;
+            int texelBytes = header.glFormat == GL_RED ? 1 : header.glFormat == GL_RG ? 2 : 4;
+            for (size_t level = 0; level < image.cached->Levels(); level++)
+            {
+                if (header.glType == 0)
+                    levelBytes.push_back(image.cached->LevelSize(level));
+                else
+                    levelBytes.push_back((size_t)max(1u, header.pixelWidth >> level) *
+                                         max(1u, header.pixelHeight >> level) * texelBytes);
+            }
+        }
+        else if (image.data)
+        {
+            entry.size = max(image.width, image.height);
+            entry.internalFormat = internalFormats[max(1, min(image.nrComponents, 4)) - 1];
+            int texelBytes = image.nrComponents == 3 ? 4 : image.nrComponents;
+            int width = image.width, height = image.height;
+            for (size_t level = 0; level <= image.mipLevels.size(); level++)
+            {
+                levelBytes.push_back((size_t)width * height * texelBytes);
+                width = max(1, width / 2);
+                height = max(1, height / 2);
+            }
+        }
+    }
+
+    // whether the levels of the texture at path can be loaded again, from its baked or decoded texture cache file
+    static bool isStreamable(const string &path)
+    {
+        return HasBakedTexture(path) || access(DecodedTextureCachePath(path).c_str(), R_OK) == 0;
+    }
+
+    // the file the levels of a texture can be restored from, nullptr if there is none
+    static shared_ptr<KtxFile> levelSource(const string &path, bool srgb)
+    {
+        shared_ptr<KtxFile> baked = OpenBakedTexture(path);
+        if (baked)
+            return baked;
+        TextureImage image;
+        if (OpenDecodedTextureCache(path, srgb, image))
+            return image.cached;
+        return nullptr;
+    }
+
+    // only levels of streamed textures that can be brought back, and never below MIN_RESIDENT_SIZE
+    static bool canDrop(const Entry &entry)
+    {
+        return entry.streamed && entry.streamable && entry.baseLevel + 1 < entry.levelBytes.size() &&
+               (entry.size >> (entry.baseLevel + 1)) >= MIN_RESIDENT_SIZE;
+    }
+
+    // the client format matching an uncompressed internal format
+    static GLenum baseFormat(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_R8:
+        case GL_RED:
+            return GL_RED;
+        case GL_RG8:
+        case GL_RG:
+            return GL_RG;
+        case GL_RGB8:
+        case GL_RGB:
+            return GL_RGB;
+        default:
+            return GL_RGBA;
+        }
+    }
+
+    // frees the largest resident level of a texture
+    void dropLevel(Entry &entry)
+    {
+        GLState::Instance().BindTexture(GL_TEXTURE_2D, entry.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.baseLevel + 1);
+        // an empty image in the texture's own format releases the memory, levels before the base level don't affect
+        // completeness
+        if (entry.compressed)
+            glCompressedTexImage2D(GL_TEXTURE_2D, entry.baseLevel, entry.internalFormat, 0, 0, 0, 0, nullptr);
+        else
+            glTexImage2D(GL_TEXTURE_2D, entry.baseLevel, entry.internalFormat, 0, 0, 0,
+                         baseFormat(entry.internalFormat), GL_UNSIGNED_BYTE, nullptr);
+        residentBytes -= entry.levelBytes[entry.baseLevel];
+        entry.baseLevel++;
+    }
+
+    // queues the upload of the missing levels of a texture down to level, they count as resident right away. A texture
+    // whose file is gone or doesn't match anymore stops streaming.
+    void streamLevels(const string &path, Entry &entry, unsigned int level)
+    {
+        shared_ptr<KtxFile> source = levelSource(path, entry.srgb);
+        if (!source || source->Levels() != entry.levelBytes.size())
+        {
+            std::cout << "WARNING::TEXTURE_CACHE:: can't stream the levels of " << path << std::endl;
+            entry.streamable = false;
+            return;
+        }
+        TextureUploader::Instance().UploadLevels(entry.id, source, level, entry.baseLevel);
+        for (size_t l = level; l < entry.baseLevel; l++)
+            residentBytes += entry.levelBytes[l];
+        entry.baseLevel = level;
+    }
+
+    // a reference without streaming makes the texture fully resident again, Update streams its missing levels in
+    bool tryAcquireCanonical(const string &key, bool streamed, unsigned int &id)
+    {
+        auto it = entries.find(key);
+        if (it == entries.end())
+            return false;
+        it->second.refCount++;
+        it->second.streamed = it->second.streamed && streamed;
+        id = it->second.id;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// CPU encoders for the block compressed formats GPUs sample directly, used to bake textures offline. Every format
+// works on 4x4 texel blocks: BC1 stores RGB in 8 bytes (two RGB565 endpoints and 2 bit indices), BC3 adds a BC4 style
+// alpha block, BC4 (RGTC1) stores one channel in 8 bytes (two 8 bit endpoints, 3 bit indices) and BC5 (RGTC2) two of
+// them. Compared to 8 bit texels that is 6:1 for RGB, 4:1 for RGBA, 2:1 for single and dual channel maps.
+//
+// This header doesn't depend on a GL loader so tools can use it, GL enum values are spelled out where needed.
+
+enum class BlockFormat {
+    BC1, // RGB
+    BC3, // RGBA
+    BC4, // R, a.k.a. RGTC1
+    BC5  // RG, a.k.a. RGTC2
+};
+
+// glInternalFormat of the format
+inline uint32_t BlockFormatGLInternalFormat(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1: return 0x83F0; // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    case BlockFormat::BC3: return 0x83F3; // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+    case BlockFormat::BC4: return 0x8DBB; // GL_COMPRESSED_RED_RGTC1
+    case BlockFormat::BC5: return 0x8DBD; // GL_COMPRESSED_RG_RGTC2
+    }
+    return 0;
+}
+
+// glBaseInternalFormat of the format
+inline uint32_t BlockFormatGLBaseFormat(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1: return 0x1907; // GL_RGB
+    case BlockFormat::BC3: return 0x1908; // GL_RGBA
+    case BlockFormat::BC4: return 0x1903; // GL_RED
+    case BlockFormat::BC5: return 0x8227; // GL_RG
+    }
+    return 0;
+}
+
+inline const char *BlockFormatName(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1: return "BC1";
+    case BlockFormat::BC3: return "BC3";
+    case BlockFormat::BC4: return "BC4/RGTC1";
+    case BlockFormat::BC5: return "BC5/RGTC2";
+    }
+    return "";
+}
+
+inline size_t BlockFormatBlockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+inline size_t CompressedImageBytes(BlockFormat format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockFormatBlockBytes(format);
+}
+
+// the format matching what the uncompressed upload in UploadTextureImage makes of an image with that many channels
+inline BlockFormat BlockFormatForChannels(int channels)
+{
+    if (channels == 1)
+        return BlockFormat::BC4;
+    if (channels == 2)
+        return BlockFormat::BC5;
+    if (channels == 4)
+        return BlockFormat::BC3;
+    return BlockFormat::BC1;
+}
+
+inline uint16_t PackRGB565(const float color[3])
+{
+    int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void UnpackRGB565(uint16_t packed, int color[3])
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// BC1 color block of 16 RGBA texels: endpoints at the extremes of the colors along their principal axis, pulled
+// in by 1/16 of the range, which lowers the average error since the extremes are rarely hit exactly
+inline void EncodeBC1Block(const uint8_t texels[16][4], uint8_t *out)
+{
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += texels[i][c] / 16.0f;
+    float covariance[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++)
+    {
+        float d[3] = {texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2]};
+        covariance[0] += d[0] * d[0];
+        covariance[1] += d[0] * d[1];
+        covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1];
+        covariance[4] += d[1] * d[2];
+        covariance[5] += d[2] * d[2];
+    }
+    // power iteration for the principal axis
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+        };
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] + (texels[i][2] - mean[2]) * axis[2];
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    float inset = (maxT - minT) / 16.0f;
+    minT += inset;
+    maxT -= inset;
+    float high[3], low[3];
+    for (int c = 0; c < 3; c++)
+    {
+        high[c] = mean[c] + axis[c] * maxT;
+        low[c] = mean[c] + axis[c] * minT;
+    }
+    uint16_t color0 = PackRGB565(high), color1 = PackRGB565(low);
+    // color0 > color1 selects the four color mode
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        UnpackRGB565(color0, palette[0]);
+        UnpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestDistance = 1 << 30;
+            for (int p = 0; p < 4; p++)
+            {
+                int dr = texels[i][0] - palette[p][0], dg = texels[i][1] - palette[p][1], db = texels[i][2] - palette[p][2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+    out[0] = (uint8_t)(color0 & 0xff);
+    out[1] = (uint8_t)(color0 >> 8);
+    out[2] = (uint8_t)(color1 & 0xff);
+    out[3] = (uint8_t)(color1 >> 8);
+    for (int b = 0; b < 4; b++)
+        out[4 + b] = (uint8_t)(indices >> (b * 8));
+}
+
+// BC4 block of 16 single channel values, in the 8 value mode spanning the block's range
+inline void EncodeBC4Block(const uint8_t values[16], uint8_t *out)
+{
+    uint8_t low = 255, high = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        low = std::min(low, values[i]);
+        high = std::max(high, values[i]);
+    }
+    out[0] = high;
+    out[1] = low;
+    uint64_t indices = 0;
+    if (high != low)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            // step 0 is the low endpoint (index 1), step 7 the high one (index 0), steps between are indices 7..2
+            int step = (int)((values[i] - low) * 7.0f / (high - low) + 0.5f);
+            int index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+            indices |= (uint64_t)index << (i * 3);
+        }
+    }
+    for (int b = 0; b < 6; b++)
+        out[2 + b] = (uint8_t)(indices >> (b * 8));
+}
+
+// compresses a width x height image of 8 bit texels with the given number of channels (1 to 4). Texels outside the
+// image in the last row and column of blocks repeat the edge.
+inline vector<uint8_t> CompressImage(const uint8_t *texels, int width, int height, int channels, BlockFormat format)
+{
+    vector<uint8_t> result(CompressedImageBytes(format, width, height));
+    size_t blockBytes = BlockFormatBlockBytes(format);
+    uint8_t *out = result.data();
+    for (int by = 0; by < height; by += 4)
+    {
+        for (int bx = 0; bx < width; bx += 4)
+        {
+            // gather the block as RGBA, missing channels read as 0 (alpha as 255)
+            uint8_t block[16][4];
+            for (int i = 0; i < 16; i++)
+            {
+                int x = std::min(bx + i % 4, width - 1), y = std::min(by + i / 4, height - 1);
+                const uint8_t *texel = texels + ((size_t)y * width + x) * channels;
+                for (int c = 0; c < 4; c++)
+                    block[i][c] = c < channels ? texel[c] : (c == 3 ? 255 : 0);
+            }
+
+            uint8_t channel[16];
+            switch (format)
+            {
+            case BlockFormat::BC1:
+                EncodeBC1Block(block, out);
+                break;
+            case BlockFormat::BC3:
+                for (int i = 0; i < 16; i++)
+                    channel[i] = block[i][3];
+                EncodeBC4Block(channel, out);
+                EncodeBC1Block(block, out + 8);
+                break;
+            case BlockFormat::BC4:
+                for (int i = 0; i < 16; i++)
+                    channel[i] = block[i][0];
+                EncodeBC4Block(channel, out);
+                break;
+            case BlockFormat::BC5:
+                for (int c = 0; c < 2; c++)
+                {
+                    for (int i = 0; i < 16; i++)
+                        channel[i] = block[i][c];
+                    EncodeBC4Block(channel, out + c * 8);
+                }
+                break;
+            }
+            out += blockBytes;
+        }
+    }
+    return result;
+}
+
+#endif
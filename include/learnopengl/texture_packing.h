@@ -0,0 +1,122 @@
+#ifndef TEXTURE_PACKING_H
+#define TEXTURE_PACKING_H
+
+#include <learnopengl/image_decoder.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Scalar material maps (specular intensity, ambient occlusion, height) only need one channel each, but every one of
+// them is a texture of its own: its own bind, its own fetch in the shader and usually three channels of memory. The
+// texture baker (--pack) packs the maps of a material into the channels of one RGBA texture instead:
+//
+//   r  specular   (texture_specular, map_Ks)
+//   g  occlusion  (texture_occlusion, map_ao in the material library's sidecar, see material_library.h)
+//   b  height     (texture_height, map_Ka)
+//   a  unused, 1
+//
+// The packed texture is a baked KTX file named after the material's specular map, or its height map if it has none:
+// specular.jpg -> specular.jpg.pack.ktx. Models replace the scalar maps of a material by it when it is up to date (see
+// PackedTextureRefs in mesh.h), as a texture_packed texture, which the texture cache loads like any baked image.
+// No GL dependency, tools use it too.
+
+enum PackedChannel {
+    PACKED_SPECULAR,
+    PACKED_OCCLUSION,
+    PACKED_HEIGHT,
+    PACKED_CHANNELS
+};
+
+// the channel a material texture type is packed into, -1 for types that aren't packed
+inline int PackedChannelForType(const string &type)
+{
+    if (type == "texture_specular")
+        return PACKED_SPECULAR;
+    if (type == "texture_occlusion")
+        return PACKED_OCCLUSION;
+    if (type == "texture_height")
+        return PACKED_HEIGHT;
+    return -1;
+}
+
+// value of a channel whose map the material doesn't have: no specular, no occlusion, flat
+inline uint8_t PackedChannelDefault(int channel)
+{
+    return channel == PACKED_OCCLUSION ? 255 : 0;
+}
+
+// path of the packed texture for the given maps (indexed by PackedChannel, empty if missing) without the .ktx of its
+// baked file, empty if neither a specular nor a height map is given
+inline string PackedTexturePath(const string maps[PACKED_CHANNELS])
+{
+    const string &key = maps[PACKED_SPECULAR].empty() ? maps[PACKED_HEIGHT] : maps[PACKED_SPECULAR];
+    return key.empty() ? string() : key + ".pack";
+}
+
+// decodes the given maps (indexed by PackedChannel, empty if missing) and packs their first channel into RGBA texels
+// the size of the largest map, smaller maps are resampled bilinearly. Returns false if a given map can't be decoded.
+inline bool PackScalarMaps(const string maps[PACKED_CHANNELS], vector<uint8_t> &texels, int &width, int &height)
+{
+    struct Map {
+        unsigned char *texels = nullptr;
+        const ImageDecoder *decoder = nullptr;
+        int width = 0, height = 0, channels = 0;
+    };
+    Map decoded[PACKED_CHANNELS];
+    bool succeeded = true;
+    width = height = 0;
+    for (int c = 0; c < PACKED_CHANNELS; c++)
+    {
+        if (maps[c].empty())
+            continue;
+        Map &map = decoded[c];
+        map.texels = DecodeImage(maps[c], map.width, map.height, map.channels, map.decoder);
+        succeeded = succeeded && map.texels;
+        width = max(width, map.width);
+        height = max(height, map.height);
+    }
+
+    if (succeeded && width > 0 && height > 0)
+    {
+        texels.assign((size_t)width * height * 4, 255);
+        for (int c = 0; c < PACKED_CHANNELS; c++)
+        {
+            const Map &map = decoded[c];
+            for (int y = 0; y < height; y++)
+            {
+                uint8_t *out = texels.data() + (size_t)y * width * 4 + c;
+                if (!map.texels)
+                {
+                    for (int x = 0; x < width; x++)
+                        out[x * 4] = PackedChannelDefault(c);
+                    continue;
+                }
+                float sy = max(0.0f, (y + 0.5f) * map.height / height - 0.5f);
+                int y0 = min((int)sy, map.height - 1), y1 = min(y0 + 1, map.height - 1);
+                float fy = sy - y0;
+                const unsigned char *top = map.texels + (size_t)y0 * map.width * map.channels;
+                const unsigned char *bottom = map.texels + (size_t)y1 * map.width * map.channels;
+                for (int x = 0; x < width; x++)
+                {
+                    float sx = max(0.0f, (x + 0.5f) * map.width / width - 0.5f);
+                    int x0 = min((int)sx, map.width - 1), x1 = min(x0 + 1, map.width - 1);
+                    float fx = sx - x0;
+                    float upper = top[x0 * map.channels] * (1.0f - fx) + top[x1 * map.channels] * fx;
+                    float lower = bottom[x0 * map.channels] * (1.0f - fx) + bottom[x1 * map.channels] * fx;
+                    out[x * 4] = (uint8_t)(upper * (1.0f - fy) + lower * fy + 0.5f);
+                }
+            }
+        }
+    }
+    else
+        succeeded = false;
+
+    for (Map &map : decoded)
+        FreeImage(map.texels, map.decoder);
+    return succeeded;
+}
+
+#endif
@@ -0,0 +1,376 @@
+#ifndef TEXTURE_UPLOADER_H
+#define TEXTURE_UPLOADER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/ktx.h>
+#include <learnopengl/texture.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+using namespace std;
+
+// Streams texel data into textures through a small ring of pixel buffer objects instead of handing client memory to
+// glTexImage2D, which makes the driver copy the whole image before the call returns. A texture is created with storage
+// for all its levels right away, then every Update copies a few chunks of rows into the next free PBO and issues
+// glTexSubImage2D from it, so the transfer to the GPU runs while the frame renders. A fence after every chunk tells
+// when its PBO can be refilled, a PBO the GPU still reads from is never waited for, the chunk is retried next frame.
+//
+// Levels are uploaded from the smallest to the largest and GL_TEXTURE_BASE_LEVEL follows the largest complete one,
+// so a texture is drawn blurry for a few frames instead of with undefined texels. The smallest level of a new texture
+// is a few bytes and is uploaded right away from client memory, so the texture has defined texels from the start. A texture can also be created with
+// only its smaller levels, the larger ones are added later with UploadLevels (see TextureCache).
+class TextureUploader
+{
+public:
+    static TextureUploader &Instance()
+    {
+        static TextureUploader instance;
+        return instance;
+    }
+
+    // creates a texture for decoded texels and queues their upload, levels before firstLevel are left out. Takes over
+    // the texels (or the mapping of the decoded texture cache), image is freed afterwards. Must be called on the GL
+    // context thread.
+    unsigned int Upload(TextureImage &image, size_t firstLevel = 0)
+    {
+        shared_ptr<TextureImage> owned = make_shared<TextureImage>(std::move(image));
+        image.data = nullptr;
+        FreeTextureImage(image);
+        if (owned->cached)
+            return Upload(owned->cached, firstLevel);
+
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        if (!owned->data)
+        {
+            FreeTextureImage(*owned);
+            return textureID;
+        }
+
+        // sized internal formats like the decoded texture cache has, levels restored from it have to match
+        static const GLenum formats[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+        static const GLenum internalFormats[4] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+        int channels = max(1, min(owned->nrComponents, 4));
+        Job job;
+        job.texture = textureID;
+        job.format = formats[channels - 1];
+        job.internalFormat = internalFormats[channels - 1];
+        job.type = GL_UNSIGNED_BYTE;
+        job.alignment = 1;
+        job.blockRows = 1;
+        int width = owned->width, height = owned->height;
+        for (size_t level = 0; level <= owned->mipLevels.size(); level++)
+        {
+            size_t rowBytes = (size_t)width * owned->nrComponents;
+            const uint8_t *data = level == 0 ? owned->data : owned->mipLevels[level - 1].data();
+            job.levels.push_back(Level{width, height, data, rowBytes, rowBytes * height});
+            width = max(1, width / 2);
+            height = max(1, height / 2);
+        }
+        // the texels have to be given back to the decoder that allocated them
+        job.owner = shared_ptr<void>(owned.get(), [owned](void *) { FreeTextureImage(*owned); });
+        start(job, min(firstLevel, job.levels.size() - 1), job.levels.size(), true);
+        return textureID;
+    }
+
+    // creates a texture for the levels of a mapped KTX file, compressed or not, and queues their upload. Levels
+    // before firstLevel are left out.
+    unsigned int Upload(const shared_ptr<KtxFile> &ktx, size_t firstLevel = 0)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        Job job = ktxJob(textureID, ktx);
+        start(job, min(firstLevel, job.levels.size() - 1), job.levels.size(), true);
+        return textureID;
+    }
+
+    // queues the upload of levels firstLevel to endLevel - 1 of a KTX file into an existing texture made from it that
+    // is missing them, because they were dropped or never loaded. The levels from endLevel on are left alone.
+    void UploadLevels(unsigned int texture, const shared_ptr<KtxFile> &ktx, size_t firstLevel, size_t endLevel)
+    {
+        Job job = ktxJob(texture, ktx);
+        endLevel = min(endLevel, job.levels.size());
+        if (firstLevel < endLevel)
+            start(job, firstLevel, endLevel, false);
+    }
+
+    // copies up to budgetBytes of queued texels into free PBOs and issues their uploads. Call once per frame on the GL
+    // context thread.
+    void Update(size_t budgetBytes = 8 << 20)
+    {
+        size_t uploaded = 0;
+        while (!jobs.empty() && uploaded < budgetBytes)
+        {
+            Slot *slot = freeSlot(false);
+            if (!slot)
+                return;
+            uploaded += uploadChunk(*slot);
+        }
+    }
+
+    // uploads everything that is queued, waiting for PBOs as needed
+    void Flush()
+    {
+        while (!jobs.empty())
+            uploadChunk(*freeSlot(true));
+    }
+
+    // drops the queued uploads of a texture that is about to be deleted
+    void Cancel(unsigned int texture)
+    {
+        for (auto it = jobs.begin(); it != jobs.end();)
+        {
+            if (it->texture == texture)
+                it = jobs.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    // bytes still waiting to be uploaded
+    size_t PendingBytes() const
+    {
+        size_t bytes = 0;
+        for (const Job &job : jobs)
+        {
+            for (size_t level = job.firstLevel; level < job.level; level++)
+                bytes += job.levels[level].bytes;
+            const Level &current = job.levels[job.level];
+            bytes += current.bytes - min(current.bytes, job.row / job.blockRows * current.rowBytes);
+        }
+        return bytes;
+    }
+
+    size_t PendingTextures() const
+    {
+        return jobs.size();
+    }
+
+    // whether uploads into the texture are queued
+    bool IsPending(unsigned int texture) const
+    {
+        for (const Job &job : jobs)
+            if (job.texture == texture)
+                return true;
+        return false;
+    }
+
+    // deletes the PBOs and drops whatever is still queued, call before the GL context goes away
+    void Release()
+    {
+        jobs.clear();
+        for (Slot &slot : slots)
+        {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+            if (slot.buffer)
+                glDeleteBuffers(1, &slot.buffer);
+        }
+        slots.clear();
+    }
+
+private:
+    // one mip level, rows are rowBytes apart (one row of 4x4 blocks for compressed formats)
+    struct Level {
+        int width;
+        int height;
+        const uint8_t *data;
+        size_t rowBytes;
+        size_t bytes;
+    };
+    struct Job {
+        unsigned int texture = 0;
+        bool compressed = false;
+        GLenum format = 0;
+        GLenum internalFormat = 0;
+        GLenum type = 0;
+        GLint alignment = 4;
+        int blockRows = 1;
+        vector<Level> levels;
+        shared_ptr<void> owner;   // keeps the texels alive until the last chunk is copied
+        size_t firstLevel = 0;    // last level to upload
+        size_t level = 0;         // level being uploaded, counts down to firstLevel
+        int row = 0;              // first row of that level not uploaded yet
+    };
+    struct Slot {
+        unsigned int buffer = 0;
+        size_t size = 0;
+        GLsync fence = nullptr;
+    };
+    enum { SLOT_COUNT = 4, SLOT_BYTES = 4 << 20 };
+
+    deque<Job> jobs;
+    vector<Slot> slots;
+    size_t nextSlot = 0;
+
+    TextureUploader() {}
+    TextureUploader(const TextureUploader &) = delete;
+    TextureUploader &operator=(const TextureUploader &) = delete;
+
+    // a job uploading all levels of a KTX file
+    static Job ktxJob(unsigned int texture, const shared_ptr<KtxFile> &ktx)
+    {
+        const KtxHeader &header = ktx->Header();
+        Job job;
+        job.texture = texture;
+        job.compressed = header.glType == 0;
+        job.format = header.glFormat;
+        job.internalFormat = header.glInternalFormat;
+        job.type = header.glType;
+        // KTX rows are padded to 4 bytes, compressed levels are split at rows of 4x4 blocks
+        job.alignment = 4;
+        job.blockRows = job.compressed ? 4 : 1;
+        for (size_t level = 0; level < ktx->Levels(); level++)
+        {
+            int width = (int)max(1u, header.pixelWidth >> level), height = (int)max(1u, header.pixelHeight >> level);
+            size_t rowGroups = (height + job.blockRows - 1) / job.blockRows;
+            job.levels.push_back(Level{width, height, ktx->LevelData(level), ktx->LevelSize(level) / rowGroups,
+                                       ktx->LevelSize(level)});
+        }
+        job.owner = ktx;
+        return job;
+    }
+
+    // allocates the storage of levels firstLevel to endLevel - 1 of the job's texture and queues their upload. A new
+    // texture gets its parameters set up as well, and its smallest level uploaded before anything samples it.
+    void start(Job &job, size_t firstLevel, size_t endLevel, bool newTexture)
+    {
+        GLState::Instance().BindTexture(GL_TEXTURE_2D, job.texture);
+        for (size_t level = firstLevel; level < endLevel; level++)
+        {
+            const Level &l = job.levels[level];
+            if (job.compressed)
+                glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, job.internalFormat, l.width, l.height, 0,
+                                       (GLsizei)l.bytes, nullptr);
+            else
+                glTexImage2D(GL_TEXTURE_2D, (GLint)level, job.internalFormat, l.width, l.height, 0, job.format, job.type,
+                             nullptr);
+        }
+        if (newTexture)
+        {
+            GLint lastLevel = (GLint)job.levels.size() - 1;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, lastLevel);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, lastLevel);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            uploadLevel(job, lastLevel);
+            if (endLevel - 1 == firstLevel)
+                return;
+            endLevel--;
+        }
+
+        job.firstLevel = firstLevel;
+        job.level = endLevel - 1;
+        job.row = 0;
+        jobs.push_back(std::move(job));
+    }
+
+    // uploads a whole level of the job from client memory into the bound texture
+    static void uploadLevel(const Job &job, size_t level)
+    {
+        const Level &l = job.levels[level];
+        glPixelStorei(GL_UNPACK_ALIGNMENT, job.alignment);
+        if (job.compressed)
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, 0, l.width, l.height, job.internalFormat,
+                                      (GLsizei)l.bytes, l.data);
+        else
+            glTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, 0, l.width, l.height, job.format, job.type, l.data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // the next PBO of the ring once the GPU is done with it. Without wait nullptr is returned if it is still in use.
+    Slot *freeSlot(bool wait)
+    {
+        if (slots.empty())
+        {
+            slots.resize(SLOT_COUNT);
+            for (Slot &slot : slots)
+                glGenBuffers(1, &slot.buffer);
+        }
+        Slot &slot = slots[nextSlot];
+        if (slot.fence)
+        {
+            GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+            if (status == GL_TIMEOUT_EXPIRED && !wait)
+                return nullptr;
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+        nextSlot = (nextSlot + 1) % slots.size();
+        return &slot;
+    }
+
+    // copies the next rows of the front job into the slot and uploads them from there, returns the bytes copied
+    size_t uploadChunk(Slot &slot)
+    {
+        Job &job = jobs.front();
+        const Level &level = job.levels[job.level];
+        int rowGroups = (level.height + job.blockRows - 1) / job.blockRows;
+        int firstGroup = job.row / job.blockRows;
+        int groupCount = (int)max<size_t>(1, SLOT_BYTES / max<size_t>(1, level.rowBytes));
+        groupCount = min(groupCount, rowGroups - firstGroup);
+        // the last row of an uncompressed level isn't padded in client memory, only KTX pads it
+        size_t bytes = min(level.bytes - firstGroup * level.rowBytes, groupCount * level.rowBytes);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        if (slot.size < bytes)
+        {
+            slot.size = max(bytes, (size_t)SLOT_BYTES);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, slot.size, nullptr, GL_STREAM_DRAW);
+        }
+        // the fence says the GPU is done with the old contents, no need to let the driver synchronize
+        const uint8_t *source = level.data + firstGroup * level.rowBytes;
+        void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        const void *pixels = nullptr;   // offset into the PBO
+        if (mapped)
+        {
+            memcpy(mapped, source, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        else
+        {
+            // the PBO couldn't be mapped, upload these rows from client memory
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            pixels = source;
+        }
+
+        int y = firstGroup * job.blockRows;
+        int height = min(level.height - y, groupCount * job.blockRows);
+        GLState::Instance().BindTexture(GL_TEXTURE_2D, job.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, job.alignment);
+        if (job.compressed)
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)job.level, 0, y, level.width, height, job.internalFormat,
+                                      (GLsizei)bytes, pixels);
+        else
+            glTexSubImage2D(GL_TEXTURE_2D, (GLint)job.level, 0, y, level.width, height, job.format, job.type, pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        if (mapped)
+            slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        job.row += groupCount * job.blockRows;
+        if (job.row >= level.height)
+        {
+            // the level is complete, let sampling use it
+            GLState::Instance().BindTexture(GL_TEXTURE_2D, job.texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)job.level);
+            if (job.level == job.firstLevel)
+                jobs.pop_front();
+            else
+            {
+                job.level--;
+                job.row = 0;
+            }
+        }
+        return bytes;
+    }
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef UNIFORM_TABLE_H
+#define UNIFORM_TABLE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+// a uniform name as the Shader setters take it: points into a string literal or std::string, nothing is copied
+struct UniformName {
+    const char *data;
+    size_t length;
+
+    UniformName(const char *name) : data(name), length(strlen(name)) {}
+    UniformName(const string &name) : data(name.data()), length(name.size()) {}
+};
+
+// Locations of all active uniforms of a linked program, enumerated once so setting a uniform doesn't cost a
+// glGetUniformLocation (a string lookup in the driver) every time. Names are found in an open addressing hash table,
+// without allocating. Arrays are in it under their name, "lights", and every element, "lights[0]" to "lights[n-1]".
+// Names the program doesn't have (or the compiler optimized away) give -1, which glUniform* ignores, like it does for
+// glGetUniformLocation's -1.
+class UniformTable
+{
+public:
+    // enumerates the active uniforms of a linked program, replacing what the table held
+    void Build(GLuint program)
+    {
+        entries.clear();
+        names.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        vector<char> buffer(max(maxLength, 1) + 16);
+        vector<pair<string, GLint>> found;
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            string name(buffer.data(), length);
+            // uniforms in blocks have no location
+            GLint location = glGetUniformLocation(program, name.c_str());
+            if (location < 0)
+                continue;
+            size_t bracket = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0 ? name.size() - 3 : string::npos;
+            if (bracket == string::npos)
+            {
+                found.push_back(make_pair(name, location));
+                continue;
+            }
+            string base = name.substr(0, bracket);
+            found.push_back(make_pair(base, location));
+            found.push_back(make_pair(name, location));
+            for (GLint element = 1; element < size; element++)
+            {
+                string elementName = base + '[' + to_string(element) + ']';
+                found.push_back(make_pair(elementName, glGetUniformLocation(program, elementName.c_str())));
+            }
+        }
+
+        size_t capacity = 16;
+        while (capacity < found.size() * 2)
+            capacity *= 2;
+        entries.assign(capacity, Entry());
+        for (const pair<string, GLint> &uniform : found)
+        {
+            uint32_t hash = hashName(uniform.first.data(), uniform.first.size());
+            size_t slot = hash & (capacity - 1);
+            while (entries[slot].location != EMPTY)
+                slot = (slot + 1) & (capacity - 1);
+            entries[slot].hash = hash;
+            entries[slot].location = uniform.second;
+            entries[slot].nameOffset = (uint32_t)names.size();
+            entries[slot].nameLength = (uint32_t)uniform.first.size();
+            names += uniform.first;
+        }
+    }
+
+    // location of the uniform, -1 if the program has none by that name
+    GLint Location(const UniformName &name) const
+    {
+        if (entries.empty())
+            return -1;
+        uint32_t hash = hashName(name.data, name.length);
+        size_t mask = entries.size() - 1;
+        for (size_t slot = hash & mask; entries[slot].location != EMPTY; slot = (slot + 1) & mask)
+        {
+            const Entry &entry = entries[slot];
+            if (entry.hash == hash && entry.nameLength == name.length &&
+                memcmp(names.data() + entry.nameOffset, name.data, name.length) == 0)
+                return entry.location;
+        }
+        return -1;
+    }
+
+private:
+    enum { EMPTY = -2 };
+    struct Entry {
+        uint32_t hash = 0;
+        GLint location = EMPTY;
+        uint32_t nameOffset = 0;
+        uint32_t nameLength = 0;
+    };
+
+    vector<Entry> entries;   // power of two sized, at most half full
+    string names;            // all names back to back
+
+    // FNV-1a
+    static uint32_t hashName(const char *name, size_t length)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; i++)
+            hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+        return hash;
+    }
+};
+
+#endif
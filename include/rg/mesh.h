@@ -8,6 +8,7 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include <learnopengl/gl_state.h>
 #include <rg/Error.h>
 struct Vertex {
     glm::vec3 Position;
@@ -45,7 +46,6 @@ public:
         unsigned int heightNr = 1;
 
         for (unsigned int i = 0; i < textures.size(); ++i) {
-            glActiveTexture(GL_TEXTURE0 + i);
             std::string name = textures[i].type;
             std::string number;
 
@@ -62,14 +62,11 @@ public:
             }
             name.append(number);
             shader.setInt(name, i); // texture_diffuse1
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            GLState::Instance().BindTexture(i, GL_TEXTURE_2D, textures[i].id);
         }
 
-        glBindVertexArray(VAO);
+        GLState::Instance().BindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-        glBindVertexArray(0);
-        glActiveTexture(GL_TEXTURE0);
     }
 private:
     unsigned int VAO;
@@ -82,7 +79,7 @@ private:
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        GLState::Instance().BindVertexArray(VAO);
 
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
@@ -105,7 +102,7 @@ private:
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, Bitangent)));
 
-        glBindVertexArray(0);
+        GLState::Instance().BindVertexArray(0);
     }
 };
 
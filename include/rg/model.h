@@ -7,7 +7,9 @@
 #include <stb_image.h>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_cache.h>
 #include <rg/mesh.h>
 
 #include <assimp/Importer.hpp>
@@ -25,6 +27,17 @@ public:
         loadModel(path);
     }
 
+    // gives back the model's references in the global TextureCache, one per texture in loaded_textures
+    ~Model() {
+        for (const Texture& texture : loaded_textures) {
+            TextureCache::Instance().Release(texture.id);
+        }
+    }
+
+    // a copy would give the references back twice
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
     void Draw(Shader& shader) {
         for (Mesh& mesh : meshes) {
             mesh.Draw(shader);
@@ -32,6 +45,9 @@ public:
     }
 
 private:
+    // path as referenced by the materials -> index in loaded_textures
+    std::unordered_map<std::string, size_t> textureIndex;
+
     void loadModel(std::string path) {
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate |
@@ -123,60 +139,22 @@ private:
             aiString str;
             mat->GetTexture(type, i, &str);
 
-            bool skip = false;
-
-            for (unsigned int j = 0; j < loaded_textures.size(); ++j) {
-                if (std::strcmp(str.C_Str(), loaded_textures[j].path.c_str()) == 0) {
-                    textures.push_back(loaded_textures[j]);
-                    skip = true;
-                    break;
-                }
+            auto loaded = textureIndex.find(str.C_Str());
+            if (loaded != textureIndex.end()) {
+                textures.push_back(loaded_textures[loaded->second]);
+                continue;
             }
 
-            if (!skip) {
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                loaded_textures.push_back(texture);
-            }
+            Texture texture;
+            texture.id = TextureCache::Instance().Acquire(this->directory + "/" + str.C_Str());
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+            textureIndex[texture.path] = loaded_textures.size();
+            loaded_textures.push_back(texture);
         }
 
     }
 };
 
-unsigned int TextureFromFile(const char* filename, std::string directory) {
-    std::string fullPath(directory + "/" + filename);
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(fullPath.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1) {
-            format = GL_RED;
-        } else if (nrComponents == 3) {
-            format = GL_RGB;
-        } else if (nrComponents == 4) {
-            format = GL_RGBA;
-        }
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_FILTER, GL_LINEAR);
-
-    } else {
-        ASSERT(false, "Failed to load texture image");
-    }
-    stbi_image_free(data);
-    return textureID;
-}
-
 #endif //PROJECT_BASE_MODEL_H
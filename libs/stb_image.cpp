@@ -1,2 +1,9 @@
+#include <learnopengl/image_pool.h>
+
+// decode buffers come from the image pool, see learnopengl/image_pool.h
+#define STBI_MALLOC(size) ImagePool::Instance().Allocate(size)
+#define STBI_REALLOC_SIZED(pointer, oldSize, newSize) ImagePool::Instance().Reallocate(pointer, newSize)
+#define STBI_FREE(pointer) ImagePool::Instance().Free(pointer)
+
 #define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
\ No newline at end of file
+#include "stb_image.h"
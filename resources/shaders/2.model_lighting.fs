@@ -1,21 +1,15 @@
 #version 330 core
 out vec4 FragColor;
 
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
+#include "frame_uniforms.glsl"
 
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
+    // specular in r, ambient occlusion in g, height in b (texture_baker --pack), instead of texture_specular1 when
+    // packed is set
+    sampler2D texture_packed1;
+    bool packed;
 
     float shininess;
 };
@@ -23,10 +17,8 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform PointLight pointLight;
 uniform Material material;
 
-uniform vec3 viewPosition;
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
@@ -39,10 +31,20 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    // combine results, one fetch per texture
+    vec3 albedo = vec3(texture(material.texture_diffuse1, TexCoords));
+    float specularStrength;
+    float occlusion = 1.0;
+    if (material.packed) {
+        vec2 maps = texture(material.texture_packed1, TexCoords).rg;
+        specularStrength = maps.r;
+        occlusion = maps.g;
+    } else {
+        specularStrength = texture(material.texture_specular1, TexCoords).r;
+    }
+    vec3 ambient = light.ambient * albedo * occlusion;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularStrength;
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -52,7 +54,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 void main()
 {
     vec3 normal = normalize(Normal);
-    vec3 viewDir = normalize(viewPosition - FragPos);
+    vec3 viewDir = normalize(viewPos - FragPos);
     vec3 result = CalcPointLight(pointLight, normal, FragPos, viewDir);
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
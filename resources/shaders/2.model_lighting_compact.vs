@@ -0,0 +1,36 @@
+#version 330 core
+// vertex shader for meshes uploaded with the compact vertex format (see CompactVertex in learnopengl/mesh.h)
+layout (location = 0) in vec4 aPos;      // xyz position within the mesh bounds, w tangent handedness (0 or 1)
+layout (location = 1) in vec2 aNormal;   // octahedral encoded normal
+layout (location = 2) in vec2 aTexCoords;
+// location 3 holds the octahedral encoded tangent, unused while the lighting has no normal mapping
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+
+uniform mat4 model;
+// bounds of the mesh, the positions are quantized to [0, 1] within them
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+// inverse transpose of the upper 3x3 of model, see learnopengl/normal_matrix.h
+uniform mat3 normalMatrix;
+
+#include "frame_uniforms.glsl"
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    FragPos = vec3(model * vec4(aPos.xyz * positionScale + positionOffset, 1.0));
+    Normal = normalMatrix * octahedralDecode(aNormal);
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
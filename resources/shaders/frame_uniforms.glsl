@@ -0,0 +1,21 @@
+// per frame camera and light, shared by all programs (see learnopengl/frame_uniforms.h)
+struct PointLight {
+    vec3 position;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    PointLight pointLight;
+    // the room's own light colors, it is lit from pointLight.position
+    vec3 roomLightAmbient;
+    vec3 roomLightDiffuse;
+    vec3 roomLightSpecular;
+};
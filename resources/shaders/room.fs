@@ -0,0 +1,71 @@
+#version 330 core
+// Blinn-Phong lit surfaces: the room and everything in it. Their textures are the layers of one texture array built by
+// a TextureArrayBuilder (learnopengl/texture_array.h) and are picked by their layer, material.texture. The light is at
+// pointLight.position, with the room light colors of FrameUniforms. Permutations (see learnopengl/shader_registry.h)
+// are selected with these defines:
+//   ALPHA_DISCARD          drops texels with alpha below 0.1, for foliage
+//   MATERIAL_SPECULAR      specular color, vec3(0.5) if not defined
+//   SHININESS_BY_TEXTURE   float[] of the specular exponent of every texture, folded into the program instead of
+//                          material.shininess
+out vec4 FragColor;
+
+struct Material {
+    sampler2DArray diffuse;
+    int texture;              // layer of the texture in diffuse
+#ifndef SHININESS_BY_TEXTURE
+    float shininess;
+#endif
+};
+
+#include "frame_uniforms.glsl"
+
+#ifndef MATERIAL_SPECULAR
+#define MATERIAL_SPECULAR vec3(0.5)
+#endif
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform Material material;
+
+#ifdef SHININESS_BY_TEXTURE
+const float textureShininess[] = SHININESS_BY_TEXTURE;
+#endif
+
+float shininess()
+{
+#ifdef SHININESS_BY_TEXTURE
+    return textureShininess[material.texture];
+#else
+    return material.shininess;
+#endif
+}
+
+void main()
+{
+    vec4 texColor = texture(material.diffuse, vec3(TexCoords, material.texture));
+#ifdef ALPHA_DISCARD
+    if (texColor.a < 0.1) {
+        discard;
+    }
+#endif
+
+    // ambient
+    vec3 ambient = roomLightAmbient * texColor.rgb;
+
+    // diffuse
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(pointLight.position - FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = roomLightDiffuse * diff * texColor.rgb;
+
+    // specular
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(norm, halfwayDir), 0.0), shininess());
+    vec3 specular = roomLightSpecular * (spec * MATERIAL_SPECULAR);
+
+    vec3 result = ambient + diffuse + specular;
+    FragColor = vec4(result, 1.0);
+}
@@ -8,13 +8,15 @@ out vec3 Normal;
 out vec3 FragPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// inverse transpose of the upper 3x3 of model, computed once per object on the CPU (see learnopengl/normal_matrix.h)
+uniform mat3 normalMatrix;
+
+#include "frame_uniforms.glsl"
 
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoords;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
@@ -10,9 +10,16 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <learnopengl/filesystem.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/frame_uniforms.h>
+#include <learnopengl/image_pool.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_registry.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/texture_array.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/texture_uploader.h>
 
 #include <iostream>
 
@@ -26,11 +33,14 @@ void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-unsigned int loadTexture(char const * path);
+std::string shininessByTextureDefine(const std::vector<float> &shininess);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// GPU memory textures may use before the least recently drawn ones lose their largest mip levels. The room texture
+// array counts against it but is pinned, only streamed model textures lose levels.
+const size_t TEXTURE_MEMORY_BUDGET = 256 * 1024 * 1024;
 
 // camera
 
@@ -138,9 +148,12 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // entry points glad wasn't generated with (program binaries) are looked up through the same loader
+    SetGLProcLoader((GLADloadproc) glfwGetProcAddress);
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    stbi_set_flip_vertically_on_load(true);
+    SetImageFlipVertically(true);
+    TextureCache::Instance().SetBudget(TEXTURE_MEMORY_BUDGET);
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
@@ -160,21 +173,22 @@ int main() {
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_MULTISAMPLE);
+    GLState &glState = GLState::Instance();
+    glState.Enable(GL_DEPTH_TEST);
+    glState.Enable(GL_MULTISAMPLE);
 
     // build and compile shaders
     // -------------------------
-    Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
-    Shader ourShader1("resources/shaders/shader1.vs", "resources/shaders/shader1.fs");
-    Shader ourShader2("resources/shaders/shader2.vs", "resources/shaders/shader2.fs");
-    Shader ourShader3("resources/shaders/shader3.vs", "resources/shaders/shader3.fs");
-    Shader ourShader4("resources/shaders/shader4.vs", "resources/shaders/shader4.fs");
-    Shader ourShader5("resources/shaders/shader5.vs", "resources/shaders/shader5.fs");
-    Shader lightShader("resources/shaders/lightcube.vs", "resources/shaders/lightcube.fs");
+    // the programs are compiled in parallel, each one is waited for when it is first used
+    SetMaxShaderCompilerThreads(0xFFFFFFFF);
+    ShaderRegistry &shaders = ShaderRegistry::Instance();
+    Shader &ourShader = shaders.Get("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+    Shader &lightShader = shaders.Get("resources/shaders/lightcube.vs", "resources/shaders/lightcube.fs");
+    // view, projection and the light of all programs
+    FrameUniforms frameUniforms;
 
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_FRONT);
+    glState.Enable(GL_CULL_FACE);
+    glState.CullFace(GL_FRONT);
 
     float vertices0[] = {
             // Positions            // Normals           // Texture Coords
@@ -267,7 +281,7 @@ int main() {
     };
     unsigned VBO, VAO;
     glGenVertexArrays(1,&VAO);
-    glBindVertexArray(VAO);
+    glState.BindVertexArray(VAO);
 
 
     glGenBuffers(1,&VBO);
@@ -282,11 +296,11 @@ int main() {
     glEnableVertexAttribArray(2);
 
     glBindBuffer(GL_ARRAY_BUFFER,0);
-    glBindVertexArray(0);
+    glState.BindVertexArray(0);
 
     unsigned VBO1, VAO1;
     glGenVertexArrays(1,&VAO1);
-    glBindVertexArray(VAO1);
+    glState.BindVertexArray(VAO1);
 
 
     glGenBuffers(1,&VBO1);
@@ -301,27 +315,37 @@ int main() {
     glEnableVertexAttribArray(2);
 
     glBindBuffer(GL_ARRAY_BUFFER,0);
-    glBindVertexArray(0);
-
-    unsigned int diffuseMap1 = loadTexture(FileSystem::getPath("resources/textures/plocice.png").c_str());
-    ourShader1.use();
-    ourShader1.setInt("material.diffuse",0);
-
-    unsigned int diffuseMap2 = loadTexture(FileSystem::getPath("resources/textures/woodfloor2.png").c_str());
-    ourShader2.use();
-    ourShader2.setInt("material.diffuse",0);
-
-    unsigned int diffuseMap3 = loadTexture(FileSystem::getPath("resources/textures/plafon1.jpg").c_str());
-    ourShader3.use();
-    ourShader3.setInt("material.diffuse",0);
-
-    unsigned int diffuseMap4 = loadTexture(FileSystem::getPath("resources/textures/zemlja.png").c_str());
-    ourShader4.use();
-    ourShader4.setInt("material.diffuse",0);
-
-    unsigned int diffuseMap5 = loadTexture(FileSystem::getPath("resources/textures/plant1.png").c_str());
-    ourShader5.use();
-    ourShader5.setInt("material.diffuse",0);
+    glState.BindVertexArray(0);
+
+    // all room textures live in the layers of one texture array, bound once per frame
+    TextureArrayBuilder roomTextures;
+    int tilesTexture = roomTextures.Add(FileSystem::getPath("resources/textures/plocice.png"));
+    int floorTexture = roomTextures.Add(FileSystem::getPath("resources/textures/woodfloor2.png"));
+    int ceilingTexture = roomTextures.Add(FileSystem::getPath("resources/textures/plafon1.jpg"));
+    int groundTexture = roomTextures.Add(FileSystem::getPath("resources/textures/zemlja.png"));
+    int plantTexture = roomTextures.Add(FileSystem::getPath("resources/textures/plant1.png"));
+
+    // the room is drawn with two permutations of one shader, with the shininess of every texture compiled in. They
+    // compile while the textures decode.
+    std::vector<float> textureShininess(roomTextures.Layers());
+    textureShininess[tilesTexture] = 100.0f;
+    textureShininess[floorTexture] = 50.0f;
+    textureShininess[ceilingTexture] = 80.0f;
+    textureShininess[groundTexture] = 45.0f;
+    textureShininess[plantTexture] = 30.0f;
+    std::vector<std::string> roomDefines = {shininessByTextureDefine(textureShininess)};
+    Shader &roomShader = shaders.Get("resources/shaders/room.vs", "resources/shaders/room.fs", roomDefines);
+    roomDefines.push_back("ALPHA_DISCARD");
+    Shader &plantShader = shaders.Get("resources/shaders/room.vs", "resources/shaders/room.fs", roomDefines);
+
+    roomTextures.Build();
+
+    roomShader.use();
+    roomShader.setInt("material.diffuse",0);
+
+    plantShader.use();
+    plantShader.setInt("material.diffuse",0);
+    plantShader.setInt("material.texture",plantTexture);
 
     //----------------------------------------------
     // load models
@@ -341,6 +365,12 @@ int main() {
     pointLight.linear = 0.09f;
     pointLight.quadratic = 0.032f;
 
+    // the room is lit from the point light's position, with colors of its own
+    glm::vec3 roomLightAmbient(0.2f), roomLightDiffuse(0.5f), roomLightSpecular(1.0f);
+
+
+    // model matrices of the objects, their normal matrices are only recomputed when they change
+    ModelTransform roomTransform, groundTransform, plantTransform, backpackTransform;
 
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -359,6 +389,9 @@ int main() {
         // -----
         processInput(window);
 
+        // keep the textures within their memory budget and stream queued texels into them
+        TextureCache::Instance().Update();
+        TextureUploader::Instance().Update();
 
         //pointLight.position = glm::vec3(4.0 * cos(currentFrame), 4.0f, 4.0 * sin(currentFrame));
         // render
@@ -367,159 +400,83 @@ int main() {
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-
-        ourShader1.use();
-        ourShader1.setVec3("pointLight.position", pointLight.position);
-        ourShader1.setVec3("viewPos", programState->camera.Position);
-
-
-        ourShader1.setVec3("pointLight.ambient", 0.2f, 0.2f, 0.2f);
-        ourShader1.setVec3("pointLight.diffuse", 0.5f, 0.5f, 0.5f);
-        ourShader1.setVec3("pointLight.specular", 1.0f, 1.0f, 1.0f);
-
-        ourShader1.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
-        ourShader1.setFloat("material.shininess", 100.0f);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap1);
-
-        glBindVertexArray(VAO);
+        // camera and light for all programs at once
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
                                                 (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+        FrameUniformData &frame = frameUniforms.data;
+        frame.projection = projection;
+        frame.view = programState->camera.GetViewMatrix();
+        frame.viewPos = programState->camera.Position;
+        frame.lightPosition = pointLight.position;
+        frame.lightAmbient = pointLight.ambient;
+        frame.lightDiffuse = pointLight.diffuse;
+        frame.lightSpecular = pointLight.specular;
+        frame.lightConstant = pointLight.constant;
+        frame.lightLinear = pointLight.linear;
+        frame.lightQuadratic = pointLight.quadratic;
+        frame.roomLightAmbient = roomLightAmbient;
+        frame.roomLightDiffuse = roomLightDiffuse;
+        frame.roomLightSpecular = roomLightSpecular;
+        frameUniforms.Upload();
+
+        roomShader.use();
+
+        glState.BindVertexArray(VAO);
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::rotate(model,glm::radians(30.0f),glm::vec3(0.0f,1.0f,0.0f));
         model = glm::scale(model,glm::vec3(30.0,30.0,30.0));
-        ourShader1.setMat4("model",model);
-        ourShader1.setMat4("projection",projection);
-        glm::mat4 view1 = programState->camera.GetViewMatrix();
-        ourShader1.setMat4("view",view1);
+        roomTransform.Set(model);
+        roomShader.setTransform(roomTransform);
+        roomTextures.Bind(0);
+        roomShader.setInt("material.texture",tilesTexture);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
         //----------------------------------------------------------------------------------------------------------------
 
-        ourShader3.use();
-        ourShader3.setVec3("pointLight.position", pointLight.position);
-        ourShader3.setVec3("viewPos", programState->camera.Position);
-
-
-        ourShader3.setVec3("pointLight.ambient", 0.2f, 0.2f, 0.2f);
-        ourShader3.setVec3("pointLight.diffuse", 0.5f, 0.5f, 0.5f);
-        ourShader3.setVec3("pointLight.specular", 1.0f, 1.0f, 1.0f);
-
-        ourShader3.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
-        ourShader3.setFloat("material.shininess", 80.0f);
-
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D,diffuseMap3);
-        ourShader3.setMat4("model",model);
-        ourShader3.setMat4("projection",projection);
-        ourShader3.setMat4("view",view1);
+        roomShader.setInt("material.texture",ceilingTexture);
         glDrawArrays(GL_TRIANGLES,6,6);
 
         //----------------------------------------------------------------------------------------------------------------
 
-        ourShader1.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D,diffuseMap1);
+        roomShader.setInt("material.texture",tilesTexture);
         glDrawArrays(GL_TRIANGLES,12,6);
 
 
         //----------------------------------------------------------------------------------------------------------------
 
-        ourShader2.use();
-        ourShader2.setVec3("pointLight.position", pointLight.position);
-        ourShader2.setVec3("viewPos", programState->camera.Position);
-
-
-        ourShader2.setVec3("pointLight.ambient", 0.2f, 0.2f, 0.2f);
-        ourShader2.setVec3("pointLight.diffuse", 0.5f, 0.5f, 0.5f);
-        ourShader2.setVec3("pointLight.specular", 1.0f, 1.0f, 1.0f);
-
-        ourShader2.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
-        ourShader2.setFloat("material.shininess", 50.0f);
-
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap2);
-        ourShader2.setMat4("model",model);
-        ourShader2.setMat4("projection",projection);
-        ourShader2.setMat4("view",view1);
+        roomShader.setInt("material.texture",floorTexture);
         glDrawArrays(GL_TRIANGLES,18,6);
 
         //----------------------------------------------------------------------------------------------------------------
 
-        ourShader4.use();
-        ourShader4.setVec3("pointLight.position", pointLight.position);
-        ourShader4.setVec3("viewPos", programState->camera.Position);
+        glState.Enable(GL_CULL_FACE);
+        glState.CullFace(GL_FRONT);
 
-
-        ourShader4.setVec3("pointLight.ambient", 0.2f, 0.2f, 0.2f);
-        ourShader4.setVec3("pointLight.diffuse", 0.5f, 0.5f, 0.5f);
-        ourShader4.setVec3("pointLight.specular", 1.0f, 1.0f, 1.0f);
-
-        ourShader4.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
-        ourShader4.setFloat("material.shininess", 45.0f);
-
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_FRONT);
-
-        glBindVertexArray(VAO1);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D,diffuseMap4);
+        glState.BindVertexArray(VAO1);
         glm::mat4 model1 = glm::mat4(1.0f);
         model1 = glm::translate(model1,glm::vec3(0.0f,-12.35f,0.0f));
         model1 = glm::rotate(model1,glm::radians(30.0f),glm::vec3(0.0f,1.0f,0.0f));
         model1 = glm::scale(model1,glm::vec3(13.0f,13.0f,13.0f));
-        ourShader4.setMat4("model",model1);
-        ourShader4.setMat4("view",view1);
-        ourShader4.setMat4("projection",projection);
+        groundTransform.Set(model1);
+        roomShader.setTransform(groundTransform);
+        roomShader.setInt("material.texture",groundTexture);
         glDrawArrays(GL_TRIANGLES,0,36);
 
-        glDisable(GL_CULL_FACE);
-
-        ourShader5.use();
-        ourShader5.setVec3("pointLight.position", pointLight.position);
-        ourShader5.setVec3("viewPos", programState->camera.Position);
-
-
-        ourShader5.setVec3("pointLight.ambient", 0.2f, 0.2f, 0.2f);
-        ourShader5.setVec3("pointLight.diffuse", 0.5f, 0.5f, 0.5f);
-        ourShader5.setVec3("pointLight.specular", 1.0f, 1.0f, 1.0f);
-
-        ourShader5.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
-        ourShader5.setFloat("material.shininess", 30.0f);
-
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D,diffuseMap5);
+        glState.Disable(GL_CULL_FACE);
 
+        plantShader.use();
         model1 = glm::mat4(1.0f);
         model1 = glm::translate(model1,glm::vec3(1.0f,-6.0f,2.5f));
         model1 = glm::rotate(model1,glm::radians(30.0f),glm::vec3(0.0f,1.0f,0.0f));
         model1 = glm::scale(model1,glm::vec3(13.0f,18.0f,13.0f));
-        ourShader5.setMat4("model",model1);
-        ourShader5.setMat4("view",view1);
-        ourShader5.setMat4("projection",projection);
+        plantTransform.Set(model1);
+        plantShader.setTransform(plantTransform);
         glDrawArrays(GL_TRIANGLES,0,6);
 
 
         /*
         ourShader.use();
-        ourShader.setVec3("pointLight.position", pointLight.position);
-        ourShader.setVec3("pointLight.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight.specular", pointLight.specular);
-        ourShader.setFloat("pointLight.constant", pointLight.constant);
-        ourShader.setFloat("pointLight.linear", pointLight.linear);
-        ourShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-        ourShader.setVec3("viewPosition", programState->camera.Position);
         ourShader.setFloat("material.shininess", 32.0f);
-        // view/projection transformations
-
-        glm::mat4 view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
 
         // render the loaded model
 
@@ -527,11 +484,15 @@ int main() {
         model = glm::translate(model,
                                programState->backpackPosition); // translate it down so it's at the center of the scene
         model = glm::scale(model, glm::vec3(programState->backpackScale));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", model);
+        backpackTransform.Set(model);
+        ourShader.setTransform(backpackTransform);
         ourModel.Draw(ourShader);
         */
-        if (programState->ImGuiEnabled)
+        if (programState->ImGuiEnabled) {
             DrawImGui(programState);
+            // the ImGui renderer restores what it changes, but not through the state cache
+            glState.Invalidate();
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -544,6 +505,9 @@ int main() {
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
+    roomTextures.Release();
+    TextureUploader::Instance().Release();
+    frameUniforms.Release();
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
@@ -613,6 +577,23 @@ void DrawImGui(ProgramState *programState) {
         ImGui::ColorEdit3("Background color", (float *) &programState->clearColor);
         ImGui::DragFloat3("Backpack position", (float*)&programState->backpackPosition);
         ImGui::DragFloat("Backpack scale", &programState->backpackScale, 0.05, 0.1, 4.0);
+        ImGui::Text("Texture memory: %zu / %zu MB (%zu MB pinned), %zu levels not resident",
+                    TextureCache::Instance().ResidentBytes() >> 20, TextureCache::Instance().Budget() >> 20,
+                    TextureCache::Instance().PinnedBytes() >> 20, TextureCache::Instance().DroppedLevels());
+        {
+            ImagePool::Stats pool = ImagePool::Instance().GetStats();
+            ImGui::Text("Image pool: %zu MB in use, %zu MB peak, %zu MB cached", pool.bytesInUse >> 20,
+                        pool.peakBytesInUse >> 20, pool.bytesCached >> 20);
+            ImGui::Text("Image churn: %zu MB decoded, %zu MB from the system, %zu/%zu reused", pool.requestedBytes >> 20,
+                        pool.systemBytes >> 20, pool.reused, pool.allocations);
+        }
+        {
+            GLState::Stats state = GLState::Instance().GetStats();
+            ImGui::Text("GL state: %zu of %zu binds skipped as redundant", state.skipped, state.calls);
+        }
+        if (TextureUploader::Instance().PendingTextures())
+            ImGui::Text("Texture uploads: %zu textures, %zu KB left", TextureUploader::Instance().PendingTextures(),
+                        TextureUploader::Instance().PendingBytes() / 1024);
 
         ImGui::DragFloat("pointLight.constant", &programState->pointLight.constant, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.linear", &programState->pointLight.linear, 0.05, 0.0, 1.0);
@@ -645,41 +626,10 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
         }
     }
 }
-unsigned int loadTexture(char const * path)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+// the SHININESS_BY_TEXTURE define of room.fs, a GLSL float array constructor
+std::string shininessByTextureDefine(const std::vector<float> &shininess) {
+    std::string define = "SHININESS_BY_TEXTURE float[](";
+    for (size_t i = 0; i < shininess.size(); i++)
+        define += (i > 0 ? ", " : "") + std::to_string(shininess[i]);
+    return define + ")";
 }
-
-
@@ -0,0 +1,186 @@
+// Compares the image decoder backends (see learnopengl/image_decoder.h) on a set of images: every backend that accepts
+// a file decodes it a number of times, the fastest run is reported together with how far its texels are off the ones
+// stb_image returns.
+//
+// usage: decode_benchmark [--runs N] [image or directory]...
+//
+// Without inputs resources/textures is used. Directories are searched recursively for png/jpg/jpeg/tga/bmp files.
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <learnopengl/image_decoder.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct BackendTotals {
+    double seconds = 0.0;
+    double stbSeconds = 0.0;   // stb_image on the same files
+    size_t files = 0;
+    size_t pixels = 0;
+};
+
+bool isImageFile(const std::string &path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string extension = path.substr(dot + 1);
+    for (char &c : extension)
+        c = (char) tolower((unsigned char) c);
+    return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" || extension == "bmp";
+}
+
+void collectImages(const std::string &path, std::vector<std::string> &images) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        std::cout << "ERROR::DECODE_BENCHMARK:: no such file or directory " << path << std::endl;
+        return;
+    }
+    if (!S_ISDIR(info.st_mode)) {
+        images.push_back(path);
+        return;
+    }
+    DIR *directory = opendir(path.c_str());
+    if (!directory)
+        return;
+    std::vector<std::string> entries;
+    while (dirent *entry = readdir(directory)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..")
+            entries.push_back(path + '/' + name);
+    }
+    closedir(directory);
+    std::sort(entries.begin(), entries.end());
+    for (const std::string &entry : entries) {
+        struct stat entryInfo;
+        if (stat(entry.c_str(), &entryInfo) != 0)
+            continue;
+        if (S_ISDIR(entryInfo.st_mode))
+            collectImages(entry, images);
+        else if (isImageFile(entry))
+            images.push_back(entry);
+    }
+}
+
+// fastest of runs decodes in seconds, the texels of the last one are returned (nullptr if the decode failed)
+unsigned char *timeDecode(const ImageDecoder &decoder, const std::string &path, int runs, double &seconds,
+                          int &width, int &height, int &channels) {
+    unsigned char *texels = nullptr;
+    seconds = 0.0;
+    for (int run = 0; run < runs; run++) {
+        decoder.Free(texels);
+        auto start = std::chrono::steady_clock::now();
+        texels = decoder.Decode(path, false, width, height, channels);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!texels)
+            return nullptr;
+        seconds = run == 0 ? elapsed : std::min(seconds, elapsed);
+    }
+    return texels;
+}
+
+int main(int argc, char **argv) {
+    int runs = 5;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--runs" && i + 1 < argc)
+            runs = std::max(1, atoi(argv[++i]));
+        else
+            inputs.push_back(argument);
+    }
+    if (inputs.empty())
+        inputs.push_back("resources/textures");
+
+    std::vector<std::string> images;
+    for (const std::string &input : inputs)
+        collectImages(input, images);
+    if (images.empty()) {
+        std::cout << "usage: decode_benchmark [--runs N] [image or directory]..." << std::endl;
+        return 1;
+    }
+
+    const std::vector<const ImageDecoder *> &decoders = ImageDecoders();
+    const ImageDecoder &stb = *decoders.back();
+    std::vector<BackendTotals> totals(decoders.size());
+    std::cout << "backends:";
+    for (const ImageDecoder *decoder : decoders)
+        std::cout << " " << decoder->Name();
+    std::cout << ", best of " << runs << " runs" << std::endl;
+
+    char line[256];
+    snprintf(line, sizeof(line), "%-36s %-14s %-14s %10s %10s %10s", "file", "backend", "size", "ms", "MPix/s", "max diff");
+    std::cout << line << std::endl;
+    for (const std::string &path : images) {
+        double stbSeconds;
+        int width, height, channels;
+        unsigned char *reference = timeDecode(stb, path, runs, stbSeconds, width, height, channels);
+        if (!reference) {
+            std::cout << "ERROR::DECODE_BENCHMARK:: stb_image failed to decode " << path << std::endl;
+            continue;
+        }
+        std::string name = path.substr(path.find_last_of('/') + 1);
+        std::string size = std::to_string(width) + "x" + std::to_string(height) + "x" + std::to_string(channels);
+        for (size_t d = 0; d < decoders.size(); d++) {
+            const ImageDecoder &decoder = *decoders[d];
+            uint8_t signature[8];
+            size_t signatureSize = 0;
+            if (FILE *file = fopen(path.c_str(), "rb")) {
+                signatureSize = fread(signature, 1, sizeof(signature), file);
+                fclose(file);
+            }
+            if (!decoder.Accepts(signature, signatureSize))
+                continue;
+
+            double seconds = stbSeconds;
+            int w = width, h = height, c = channels;
+            unsigned char *texels = &decoder == &stb ? nullptr : timeDecode(decoder, path, runs, seconds, w, h, c);
+            std::string difference = "-";
+            if (&decoder != &stb) {
+                if (!texels) {
+                    snprintf(line, sizeof(line), "%-36s %-14s failed", name.c_str(), decoder.Name());
+                    std::cout << line << std::endl;
+                    continue;
+                }
+                if (w != width || h != height || c != channels)
+                    difference = "layout";
+                else {
+                    int maxDifference = 0;
+                    for (size_t i = 0; i < (size_t) width * height * channels; i++)
+                        maxDifference = std::max(maxDifference, std::abs((int) texels[i] - (int) reference[i]));
+                    difference = std::to_string(maxDifference);
+                }
+                decoder.Free(texels);
+            }
+            snprintf(line, sizeof(line), "%-36s %-14s %-14s %10.2f %10.1f %10s", name.c_str(), decoder.Name(),
+                     size.c_str(), seconds * 1000.0, width * (double) height / seconds / 1e6, difference.c_str());
+            std::cout << line << std::endl;
+            totals[d].seconds += seconds;
+            totals[d].stbSeconds += stbSeconds;
+            totals[d].files++;
+            totals[d].pixels += (size_t) width * height;
+        }
+        stb.Free(reference);
+    }
+
+    std::cout << std::endl;
+    for (size_t d = 0; d < decoders.size(); d++) {
+        if (totals[d].files == 0)
+            continue;
+        snprintf(line, sizeof(line), "%-14s %3zu files %10.2f ms %10.1f MPix/s %8.2fx stb_image", decoders[d]->Name(),
+                 totals[d].files, totals[d].seconds * 1000.0, totals[d].pixels / totals[d].seconds / 1e6,
+                 totals[d].stbSeconds / totals[d].seconds);
+        std::cout << line << std::endl;
+    }
+    ImagePool::Stats pool = ImagePool::Instance().GetStats();
+    std::cout << "image pool: " << (pool.requestedBytes >> 20) << " MB decoded, " << (pool.systemBytes >> 20)
+              << " MB from the system, peak " << (pool.peakBytesInUse >> 20) << " MB in use" << std::endl;
+    return 0;
+}
@@ -0,0 +1,275 @@
+// Bakes images into block compressed KTX files with a full mip chain, which LoadBakedTexture uploads as they are
+// instead of decoding the image and generating mipmaps at runtime.
+//
+// usage: texture_baker [--force] [--no-flip] [--linear] [--format bc1|bc3|bc4|bc5] <image or directory>...
+//        texture_baker --pack [--force] [--no-flip] [--format bc1|bc3|bc5] <material library (.mtl)>...
+//
+// Directories are searched recursively for png/jpg/jpeg/tga/bmp files. Every image gets a <image>.ktx next to it,
+// images whose baked file is up to date are skipped unless --force is given. Without --format the format follows the
+// channel count: BC4 (RGTC1) for one channel, BC5 (RGTC2) for two, BC1 for RGB and BC3 for RGBA. Images are flipped
+// vertically like main() tells the image decoders to, --no-flip keeps them as they are in the file. The mip chain treats RGB as
+// sRGB colors, bake normal, specular and height maps with --linear (see mip_chain.h).
+//
+// --pack packs the scalar maps of every material in the given OBJ material libraries (map_Ks specular, map_ao
+// occlusion, usually from the library's .maps sidecar, map_Ka height) into the channels of one RGBA texture, see
+// texture_packing.h and material_library.h. Without a height map only
+// two channels carry data and the texture is BC5, which keeps them independent at a byte per texel. With one it is
+// uncompressed unless --format is given: the channels are unrelated and suffer from sharing BC1 endpoints.
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <learnopengl/image_decoder.h>
+#include <learnopengl/ktx.h>
+#include <learnopengl/material_library.h>
+#include <learnopengl/mip_chain.h>
+#include <learnopengl/texture_compression.h>
+#include <learnopengl/texture_packing.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+struct BakeOptions {
+    bool force = false;
+    bool pack = false;
+    bool srgb = true;
+    bool hasFormat = false;
+    BlockFormat format = BlockFormat::BC1;
+};
+
+struct BakeTotals {
+    size_t images = 0;
+    size_t skipped = 0;
+    size_t failed = 0;
+    size_t uncompressedBytes = 0;
+    size_t compressedBytes = 0;
+};
+
+bool isImageFile(const std::string &path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string extension = path.substr(dot + 1);
+    for (char &c : extension)
+        c = (char) tolower((unsigned char) c);
+    return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" || extension == "bmp";
+}
+
+bool isUpToDate(const std::string &imagePath) {
+    struct stat baked, image;
+    if (stat((imagePath + ".ktx").c_str(), &baked) != 0 || stat(imagePath.c_str(), &image) != 0)
+        return false;
+    return baked.st_mtime >= image.st_mtime;
+}
+
+// writes texels and their mip chain down to 1x1 to a KTX file, every level block compressed on its own, or as they are
+// if format is nullptr
+void writeBaked(const std::string &name, const std::string &output, const uint8_t *texels, int width, int height,
+                int channels, bool srgb, const BlockFormat *format, BakeTotals &totals) {
+    static const uint32_t formats[4] = {0x1903, 0x8227, 0x1907, 0x1908};          // GL_RED, GL_RG, GL_RGB, GL_RGBA
+    static const uint32_t internalFormats[4] = {0x8229, 0x822B, 0x8051, 0x8058};  // GL_R8, GL_RG8, GL_RGB8, GL_RGBA8
+    std::vector<std::vector<uint8_t>> mipLevels = BuildMipChain(texels, width, height, channels, srgb);
+    std::vector<KtxLevel> levels;
+    int levelWidth = width, levelHeight = height;
+    size_t uncompressedBytes = 0, compressedBytes = 0;
+    for (size_t i = 0; i <= mipLevels.size(); i++) {
+        const uint8_t *level = i == 0 ? texels : mipLevels[i - 1].data();
+        KtxLevel baked;
+        if (format)
+            baked.data = CompressImage(level, levelWidth, levelHeight, channels, *format);
+        else
+            baked = KtxUncompressedLevel(level, levelWidth, levelHeight, channels);
+        uncompressedBytes += (size_t) levelWidth * levelHeight * channels;
+        compressedBytes += baked.data.size();
+        levels.push_back(std::move(baked));
+        levelWidth = std::max(1, levelWidth / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+
+    bool written;
+    if (format)
+        written = KtxFile::Write(output, 0, 1, 0, BlockFormatGLInternalFormat(*format), BlockFormatGLBaseFormat(*format),
+                                 (uint32_t) width, (uint32_t) height, levels);
+    else
+        written = KtxFile::Write(output, 0x1401 /* GL_UNSIGNED_BYTE */, 1, formats[channels - 1],
+                                 internalFormats[channels - 1], formats[channels - 1], (uint32_t) width,
+                                 (uint32_t) height, levels);
+    if (!written) {
+        std::cout << "ERROR::TEXTURE_BAKER:: failed to write " << output << std::endl;
+        totals.failed++;
+        return;
+    }
+    std::cout << name << ": " << width << "x" << height << ", " << channels << " channels -> "
+              << (format ? BlockFormatName(*format) : "uncompressed") << ", " << levels.size() << " levels, "
+              << uncompressedBytes / 1024 << " KB -> " << compressedBytes / 1024 << " KB" << std::endl;
+    totals.images++;
+    totals.uncompressedBytes += uncompressedBytes;
+    totals.compressedBytes += compressedBytes;
+}
+
+void bakeImage(const std::string &path, const BakeOptions &options, BakeTotals &totals) {
+    if (!options.force && isUpToDate(path)) {
+        totals.skipped++;
+        return;
+    }
+
+    int width, height, channels;
+    const ImageDecoder *decoder;
+    unsigned char *texels = DecodeImage(path, width, height, channels, decoder);
+    if (!texels) {
+        std::cout << "ERROR::TEXTURE_BAKER:: failed to decode " << path << std::endl;
+        totals.failed++;
+        return;
+    }
+    BlockFormat format = options.hasFormat ? options.format : BlockFormatForChannels(channels);
+    writeBaked(path, path + ".ktx", texels, width, height, channels, options.srgb, &format, totals);
+    FreeImage(texels, decoder);
+}
+
+bool isNewer(const std::string &path, const std::string &than) {
+    struct stat file, other;
+    return stat(path.c_str(), &file) == 0 && stat(than.c_str(), &other) == 0 && file.st_mtime > other.st_mtime;
+}
+
+void packMaterials(const std::string &path, const BakeOptions &options, BakeTotals &totals) {
+    std::map<std::string, MaterialMaps> materials;
+    if (!MaterialLibrary::Read(path, materials)) {
+        std::cout << "ERROR::TEXTURE_BAKER:: can't read material library " << path << std::endl;
+        totals.failed++;
+        return;
+    }
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+    // the first map of each kind, like the models use
+    static const MaterialMapKind kinds[PACKED_CHANNELS] = {MATERIAL_MAP_SPECULAR, MATERIAL_MAP_OCCLUSION,
+                                                           MATERIAL_MAP_HEIGHT};
+    for (const auto &material : materials) {
+        std::string maps[PACKED_CHANNELS], relative[PACKED_CHANNELS];
+        for (int c = 0; c < PACKED_CHANNELS; c++) {
+            const std::vector<std::string> &kindMaps = material.second.maps[kinds[c]];
+            if (kindMaps.empty())
+                continue;
+            relative[c] = kindMaps[0];
+            maps[c] = directory + '/' + kindMaps[0];
+        }
+        std::string packed = PackedTexturePath(relative);
+        if (packed.empty())
+            continue;
+        std::string output = directory + '/' + packed + ".ktx";
+        bool upToDate = !options.force && access(output.c_str(), R_OK) == 0;
+        for (const std::string &map : maps)
+            upToDate = upToDate && (map.empty() || !isNewer(map, output));
+        if (upToDate) {
+            totals.skipped++;
+            continue;
+        }
+
+        std::vector<uint8_t> texels;
+        int width, height;
+        if (!PackScalarMaps(maps, texels, width, height)) {
+            std::cout << "ERROR::TEXTURE_BAKER:: failed to decode the maps of " << output << std::endl;
+            totals.failed++;
+            continue;
+        }
+        BlockFormat format = options.hasFormat ? options.format : BlockFormat::BC5;
+        bool compress = options.hasFormat || maps[PACKED_HEIGHT].empty();
+        writeBaked(directory + '/' + packed, output, texels.data(), width, height, 4, false, compress ? &format : nullptr,
+                   totals);
+    }
+}
+
+void bakePath(const std::string &path, const BakeOptions &options, BakeTotals &totals) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        std::cout << "ERROR::TEXTURE_BAKER:: no such file or directory " << path << std::endl;
+        totals.failed++;
+        return;
+    }
+    if (!S_ISDIR(info.st_mode)) {
+        bakeImage(path, options, totals);
+        return;
+    }
+
+    DIR *directory = opendir(path.c_str());
+    if (!directory)
+        return;
+    std::vector<std::string> entries;
+    while (dirent *entry = readdir(directory)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..")
+            entries.push_back(path + '/' + name);
+    }
+    closedir(directory);
+    std::sort(entries.begin(), entries.end());
+    for (const std::string &entry : entries) {
+        struct stat entryInfo;
+        if (stat(entry.c_str(), &entryInfo) != 0)
+            continue;
+        if (S_ISDIR(entryInfo.st_mode))
+            bakePath(entry, options, totals);
+        else if (isImageFile(entry))
+            bakeImage(entry, options, totals);
+    }
+}
+
+int main(int argc, char **argv) {
+    BakeOptions options;
+    bool flip = true;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--force")
+            options.force = true;
+        else if (argument == "--pack")
+            options.pack = true;
+        else if (argument == "--no-flip")
+            flip = false;
+        else if (argument == "--linear")
+            options.srgb = false;
+        else if (argument == "--format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            options.hasFormat = true;
+            if (format == "bc1")
+                options.format = BlockFormat::BC1;
+            else if (format == "bc3")
+                options.format = BlockFormat::BC3;
+            else if (format == "bc4")
+                options.format = BlockFormat::BC4;
+            else if (format == "bc5")
+                options.format = BlockFormat::BC5;
+            else {
+                std::cout << "unknown format " << format << std::endl;
+                return 1;
+            }
+        } else
+            inputs.push_back(argument);
+    }
+    if (inputs.empty()) {
+        std::cout << "usage: texture_baker [--force] [--no-flip] [--linear] [--format bc1|bc3|bc4|bc5] <image or directory>..."
+                  << std::endl;
+        std::cout << "       texture_baker --pack [--force] [--no-flip] [--format bc1|bc3|bc5] <material library>..." << std::endl;
+        return 1;
+    }
+
+    SetImageFlipVertically(flip);
+    BakeTotals totals;
+    for (const std::string &input : inputs) {
+        if (options.pack)
+            packMaterials(input, options, totals);
+        else
+            bakePath(input, options, totals);
+    }
+
+    std::cout << totals.images << " baked, " << totals.skipped << " up to date, " << totals.failed << " failed";
+    if (totals.compressedBytes > 0)
+        std::cout << ", " << totals.uncompressedBytes / 1024 << " KB -> " << totals.compressedBytes / 1024 << " KB ("
+                  << (double) totals.uncompressedBytes / totals.compressedBytes << "x smaller)";
+    std::cout << std::endl;
+    return totals.failed ? 1 : 0;
+}